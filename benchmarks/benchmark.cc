@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/maxtree_stats.h"
+#include "../include/misc/allocator.h"
+#include "image_generators.h"
+#include "scaling.h"
+
+/*
+ * Max-tree benchmark over generated or loaded images, sweeping image sizes
+ * and thread counts. Every configuration runs --repeat times, and the
+ * fastest run is reported with its phase timings, as CSV or JSON.
+ *
+ *   benchmark [--generators noise,gradient,fractal,plateaus]
+ *             [--types u8,u16,u32,f32] [--dims 2,3] [--sizes 1,4,16]
+ *             [--threads 1,2,4,...] [--repeat 3] [--format csv|json]
+ *             [--output file] [--budget-mb 0] [--allocator heap|arena]
+ *             [--edge-sort radix|merge]
+ *   benchmark --load file --shape 1024x768[x64] --type u16 ...
+ *   benchmark --scaling strong|weak [--stream-mb 512] ...
+ *
+ * Sizes are in megapixels. Loaded images are raw arrays in native byte
+ * order, with the first dimension varying fastest. Progress is logged only
+ * if the results are written to a file. A memory budget other than 0 is
+ * passed to memory_tracker, see include/misc/memory_tracker.h. The arena
+ * allocator keeps working buffers in huge pages across repeats. The merge
+ * edge sort merges sorted runs per subgraph instead of radix sorting all
+ * exported edges, see pmt::edge_sort.
+ *
+ * The scaling report has a row per thread count and phase instead. Strong
+ * scaling keeps the first size, weak scaling gives every thread that many
+ * megapixels. Each row has the parallel efficiency relative to one thread
+ * (strong: T1 / (p Tp), weak: T1 / Tp), the share of the total time, and
+ * the achieved bandwidth from the modelled bytes of the phase (scaling.h)
+ * against a STREAM triad with the same threads. A phase with a low
+ * efficiency near the STREAM bandwidth is memory bound; far below it, the
+ * time goes to barriers or sequential work such as partition_offsets.
+ */
+
+using index_t = uint32_t;
+
+struct Options
+{
+  std::vector<std::string> generators = {"noise", "gradient", "fractal", "plateaus"};
+  std::vector<std::string> types = {"u8", "u16", "u32", "f32"};
+  std::vector<unsigned> dims = {2, 3};
+  std::vector<double> sizes = {1, 4, 16};
+  std::vector<size_t> threads;
+  unsigned repeat = 3;
+  std::string format = "csv";
+  std::string output;
+  std::string load;
+  std::vector<size_t> shape;
+  std::string type;
+  std::string scaling;
+  double stream_mb = 512;
+  double budget_mb = 0;
+  std::string allocator = "heap";
+  std::string edge_sort = "radix";
+};
+
+struct Result
+{
+  std::string input;
+  std::string type;
+  std::vector<size_t> shape;
+  size_t threads;
+  unsigned repeat;
+  double seconds;
+  pmt::MaxtreeStats stats;
+  std::vector<double> phase_bytes;
+};
+
+template <typename T>
+std::vector<T> parse_list(char const* arg, char separator = ',')
+{
+  std::vector<T> xs;
+  std::stringstream ss(arg);
+  std::string item;
+
+  while (std::getline(ss, item, separator))
+  {
+    std::stringstream is(item);
+    T x;
+
+    is >> x;
+    check(!is.fail());
+    xs.push_back(x);
+  }
+
+  return xs;
+}
+
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if (arg == "--help")
+    {
+      out("see the comment in benchmarks/benchmark.cc for the options");
+      exit(0);
+    }
+
+    check(i + 1 < argc);
+
+    char const* value = argv[++i];
+
+    if (arg == "--generators") options.generators = parse_list<std::string>(value);
+    else if (arg == "--types") options.types = parse_list<std::string>(value);
+    else if (arg == "--dims") options.dims = parse_list<unsigned>(value);
+    else if (arg == "--sizes") options.sizes = parse_list<double>(value);
+    else if (arg == "--threads") options.threads = parse_list<size_t>(value);
+    else if (arg == "--repeat") options.repeat = std::max(atoi(value), 1);
+    else if (arg == "--format") options.format = value;
+    else if (arg == "--output") options.output = value;
+    else if (arg == "--load") options.load = value;
+    else if (arg == "--shape") options.shape = parse_list<size_t>(value, 'x');
+    else if (arg == "--type") options.type = value;
+    else if (arg == "--scaling") options.scaling = value;
+    else if (arg == "--stream-mb") options.stream_mb = atof(value);
+    else if (arg == "--budget-mb") options.budget_mb = atof(value);
+    else if (arg == "--allocator") options.allocator = value;
+    else if (arg == "--edge-sort") options.edge_sort = value;
+    else
+    {
+      err("unknown option " << arg);
+    }
+  }
+
+  if (options.threads.empty())
+  {
+    size_t max_threads = pmt::thread_pool.max_threads();
+
+    for (size_t t = 1; t < max_threads; t *= 2U)
+    {
+      options.threads.push_back(t);
+    }
+
+    options.threads.push_back(max_threads);
+  }
+
+  check(options.format == "csv" || options.format == "json");
+  check(options.scaling.empty() || options.scaling == "strong" || options.scaling == "weak");
+  check(options.scaling != "weak" || options.load.empty());
+  check(options.allocator == "heap" || options.allocator == "arena");
+  check(options.edge_sort == "radix" || options.edge_sort == "merge");
+
+  return options;
+}
+
+/*
+ * Side lengths of an image of about megapixels million pixels
+ */
+std::vector<size_t> shape_of_size(double megapixels, unsigned n_dimensions)
+{
+  size_t side = std::max(size_t(std::round(std::pow(megapixels * 1e6, 1.0 / n_dimensions))), size_t(1));
+
+  return std::vector<size_t>(n_dimensions, side);
+}
+
+template <typename value_t, size_t n_dimensions>
+void run(
+  Options const& options,
+  std::string const& input,
+  std::string const& type,
+  std::vector<size_t> const& shape,
+  value_t const* values,
+  std::vector<Result>* results)
+{
+  using image_t = typename pmt::image<index_t, value_t, n_dimensions>::type;
+
+  pmt::Dimensions<n_dimensions> dims;
+
+  for (size_t d = 0; d < n_dimensions; ++d)
+  {
+    dims[d] = shape[d];
+  }
+
+  image_t img(values, dims);
+  size_t n = dims.length();
+  index_t* parents = new index_t[n];
+
+  for (size_t threads : options.threads)
+  {
+    pmt::thread_pool.set_n_active_threads(threads);
+
+    Result result{input, type, shape, pmt::thread_pool.n_active_threads(), options.repeat, 0, {}, {}};
+
+    for (unsigned r = 0; r < options.repeat; ++r)
+    {
+      pmt::MaxtreeStats stats;
+
+      pmt::maxtree(img, parents, &stats);
+
+      if (r == 0 || stats.total_seconds < result.seconds)
+      {
+        result.seconds = stats.total_seconds;
+        result.stats = stats;
+      }
+    }
+
+    result.phase_bytes.resize(pmt::n_maxtree_phases);
+    pmt::maxtree_phase_bytes<index_t, value_t>(result.stats, result.phase_bytes.data());
+
+    info(input << " " << type << " " << n << " pixels, " << result.threads << " threads: " <<
+      n / 1e6 / result.seconds << " megapixel/s");
+
+    results->push_back(result);
+  }
+
+  pmt::thread_pool.set_n_active_threads(0);
+
+  delete[] parents;
+}
+
+template <typename value_t, size_t n_dimensions>
+void run_generated(
+  Options const& options,
+  std::string const& type,
+  std::vector<Result>* results)
+{
+  if (options.scaling == "weak")
+  {
+    // a run per thread count, with an image that grows with it
+    for (size_t threads : options.threads)
+    {
+      Options weak = options;
+
+      weak.scaling.clear();
+      weak.sizes = {options.sizes[0] * threads};
+      weak.threads = {threads};
+      run_generated<value_t, n_dimensions>(weak, type, results);
+    }
+
+    return;
+  }
+
+  for (double size : options.sizes)
+  {
+    std::vector<size_t> shape = shape_of_size(size, n_dimensions);
+    pmt::Dimensions<n_dimensions> dims;
+
+    for (size_t d = 0; d < n_dimensions; ++d)
+    {
+      dims[d] = shape[d];
+    }
+
+    value_t* values = new value_t[dims.length()];
+
+    for (std::string const& name : options.generators)
+    {
+      pmt::generator_t generator;
+
+      if (!pmt::parse_generator(name.c_str(), &generator))
+      {
+        err("unknown generator " << name);
+      }
+
+      pmt::generate_image(generator, dims, values);
+      run<value_t, n_dimensions>(options, name, type, shape, values, results);
+    }
+
+    delete[] values;
+  }
+}
+
+template <typename value_t, size_t n_dimensions>
+void run_loaded(Options const& options, std::vector<Result>* results)
+{
+  size_t n = 1;
+
+  for (size_t len : options.shape)
+  {
+    n *= len;
+  }
+
+  value_t* values = new value_t[n];
+  std::ifstream is(options.load, std::ios::binary);
+
+  check(is.good());
+  is.read(reinterpret_cast<char*>(values), n * sizeof(value_t));
+  check(size_t(is.gcount()) == n * sizeof(value_t));
+
+  run<value_t, n_dimensions>(options, options.load, options.type, options.shape, values, results);
+
+  delete[] values;
+}
+
+template <size_t n_dimensions>
+void run_type(Options const& options, std::string const& type, std::vector<Result>* results)
+{
+  bool loaded = !options.load.empty();
+
+  if (type == "u8")
+  {
+    loaded ? run_loaded<uint8_t, n_dimensions>(options, results) : run_generated<uint8_t, n_dimensions>(options, type, results);
+  }
+  else if (type == "u16")
+  {
+    loaded ? run_loaded<uint16_t, n_dimensions>(options, results) : run_generated<uint16_t, n_dimensions>(options, type, results);
+  }
+  else if (type == "u32")
+  {
+    loaded ? run_loaded<uint32_t, n_dimensions>(options, results) : run_generated<uint32_t, n_dimensions>(options, type, results);
+  }
+  else if (type == "f32")
+  {
+    loaded ? run_loaded<float, n_dimensions>(options, results) : run_generated<float, n_dimensions>(options, type, results);
+  }
+  else
+  {
+    err("unknown type " << type);
+  }
+}
+
+void run_dims(Options const& options, unsigned n_dimensions, std::string const& type, std::vector<Result>* results)
+{
+  if (n_dimensions == 2)
+  {
+    run_type<2>(options, type, results);
+  }
+  else if (n_dimensions == 3)
+  {
+    run_type<3>(options, type, results);
+  }
+  else
+  {
+    err("only 2-D and 3-D images are supported");
+  }
+}
+
+std::string shape_string(std::vector<size_t> const& shape)
+{
+  std::string s;
+
+  for (size_t d = 0; d < shape.size(); ++d)
+  {
+    s += (d == 0 ? "" : "x") + std::to_string(shape[d]);
+  }
+
+  return s;
+}
+
+void write_csv(std::ostream& os, std::vector<Result> const& results)
+{
+  os << "input,type,shape,n_pixels,threads,repeat,seconds,megapixels_per_s";
+
+  for (unsigned k = 0; k < pmt::n_maxtree_phases; ++k)
+  {
+    os << "," << pmt::maxtree_phase_name(k) << "_seconds";
+  }
+
+  os << ",n_reduced_edges,n_partitions,n_partition_rounds,peak_bytes,low_memory\n";
+
+  for (Result const& r : results)
+  {
+    os << r.input << "," << r.type << "," << shape_string(r.shape) << "," << r.stats.n_nodes << ",";
+    os << r.threads << "," << r.repeat << "," << r.seconds << "," << r.stats.n_nodes / 1e6 / r.seconds;
+
+    for (unsigned k = 0; k < pmt::n_maxtree_phases; ++k)
+    {
+      os << "," << r.stats.phase_seconds[k];
+    }
+
+    os << "," << r.stats.n_reduced_edges << "," << r.stats.partition_edge_counts.size();
+    os << "," << r.stats.n_partition_rounds << "," << r.stats.peak_bytes << "," << r.stats.low_memory << "\n";
+  }
+}
+
+void write_json(std::ostream& os, std::vector<Result> const& results)
+{
+  os << "[\n";
+
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    Result const& r = results[i];
+
+    os << "{\"input\": \"" << r.input << "\", \"type\": \"" << r.type << "\", ";
+    os << "\"shape\": \"" << shape_string(r.shape) << "\", \"threads\": " << r.threads << ", ";
+    os << "\"repeat\": " << r.repeat << ", \"seconds\": " << r.seconds << ", ";
+    os << "\"megapixels_per_s\": " << r.stats.n_nodes / 1e6 / r.seconds << ",\n\"stats\": ";
+    r.stats.write_json(os);
+    os << "}" << (i + 1U == results.size() ? "" : ",") << "\n";
+  }
+
+  os << "]\n";
+}
+
+/*
+ * A row per result and phase, with efficiencies relative to the result of
+ * the same input, type and number of dimensions with the fewest threads.
+ * Weak scaling varies the shape with the threads, so it is not compared.
+ */
+void write_scaling(
+  std::ostream& os,
+  Options const& options,
+  std::vector<Result> const& results,
+  std::vector<double> const& stream_bandwidth)
+{
+  bool json = options.format == "json";
+  bool first_row = true;
+
+  auto const& find_base = [&](Result const& r) {
+    Result const* base = nullptr;
+
+    // the first of these results if several have the fewest threads
+    for (Result const& other : results)
+    {
+      if (other.input == r.input && other.type == r.type &&
+        other.shape.size() == r.shape.size() &&
+        (base == nullptr || other.threads < base->threads))
+      {
+        base = &other;
+      }
+    }
+
+    return base;
+  };
+
+  if (json)
+  {
+    os << "[\n";
+  }
+  else
+  {
+    os << "scaling,input,type,shape,threads,phase,seconds,time_share,efficiency,";
+    os << "bytes,gb_per_s,stream_gb_per_s,bandwidth_fraction\n";
+  }
+
+  for (Result const& r : results)
+  {
+    Result const* base = find_base(r);
+    size_t t = std::find(options.threads.begin(), options.threads.end(), r.threads) - options.threads.begin();
+    double stream = t < stream_bandwidth.size() ? stream_bandwidth[t] : 0.0;
+    double scale = options.scaling == "strong" ? double(r.threads) / base->threads : 1.0;
+
+    for (unsigned k = 0; k <= pmt::n_maxtree_phases; ++k)
+    {
+      bool total = k == pmt::n_maxtree_phases;
+      char const* phase = total ? "total" : pmt::maxtree_phase_name(k);
+      double seconds = total ? r.seconds : r.stats.phase_seconds[k];
+      double base_seconds = total ? base->seconds : base->stats.phase_seconds[k];
+      double bytes = 0;
+
+      if (seconds == 0 && !total) continue;
+
+      for (unsigned j = 0; j < pmt::n_maxtree_phases; ++j)
+      {
+        bytes += (total || j == k) ? r.phase_bytes[j] : 0.0;
+      }
+
+      double efficiency = base_seconds / (scale * seconds);
+      double bandwidth = bytes / seconds;
+
+      if (json)
+      {
+        os << (first_row ? "" : ",\n");
+        os << "{\"scaling\": \"" << options.scaling << "\", \"input\": \"" << r.input << "\", ";
+        os << "\"type\": \"" << r.type << "\", \"shape\": \"" << shape_string(r.shape) << "\", ";
+        os << "\"threads\": " << r.threads << ", \"phase\": \"" << phase << "\", ";
+        os << "\"seconds\": " << seconds << ", \"time_share\": " << seconds / r.seconds << ", ";
+        os << "\"efficiency\": " << efficiency << ", \"bytes\": " << bytes << ", ";
+        os << "\"gb_per_s\": " << bandwidth / 1e9 << ", \"stream_gb_per_s\": " << stream / 1e9 << ", ";
+        os << "\"bandwidth_fraction\": " << (stream > 0 ? bandwidth / stream : 0.0) << "}";
+      }
+      else
+      {
+        os << options.scaling << "," << r.input << "," << r.type << "," << shape_string(r.shape) << ",";
+        os << r.threads << "," << phase << "," << seconds << "," << seconds / r.seconds << ",";
+        os << efficiency << "," << bytes << "," << bandwidth / 1e9 << "," << stream / 1e9 << ",";
+        os << (stream > 0 ? bandwidth / stream : 0.0) << "\n";
+      }
+
+      first_row = false;
+    }
+  }
+
+  if (json)
+  {
+    os << "\n]\n";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options = parse_options(argc, argv);
+  std::vector<Result> results;
+  std::vector<double> stream_bandwidth;
+
+  pmt::HugePageArena arena;
+
+  pmt::memory_tracker.set_budget(size_t(options.budget_mb * 1e6));
+
+  if (options.allocator == "arena")
+  {
+    pmt::set_allocator(&arena);
+  }
+
+  pmt::edge_sort = options.edge_sort == "merge" ? pmt::edge_sort_merge : pmt::edge_sort_radix;
+
+  // the logger writes to stdout as well
+  if (options.output.empty())
+  {
+    pmt::show_info = false;
+  }
+
+  if (!options.scaling.empty())
+  {
+    std::sort(options.threads.begin(), options.threads.end());
+
+    if (options.scaling == "strong")
+    {
+      options.sizes.resize(1);
+    }
+
+    for (size_t threads : options.threads)
+    {
+      pmt::thread_pool.set_n_active_threads(threads);
+      stream_bandwidth.push_back(pmt::stream_triad_bandwidth(size_t(options.stream_mb * 1e6)));
+      info("stream triad, " << threads << " threads: " << stream_bandwidth.back() / 1e9 << " GB/s");
+    }
+
+    pmt::thread_pool.set_n_active_threads(0);
+  }
+
+  if (!options.load.empty())
+  {
+    check(!options.shape.empty() && !options.type.empty());
+    run_dims(options, options.shape.size(), options.type, &results);
+  }
+  else
+  {
+    for (unsigned n_dimensions : options.dims)
+    {
+      for (std::string const& type : options.types)
+      {
+        run_dims(options, n_dimensions, type, &results);
+      }
+    }
+  }
+
+  std::ofstream file;
+
+  if (!options.output.empty())
+  {
+    file.open(options.output);
+    check(file.good());
+  }
+
+  std::ostream& os = options.output.empty() ? std::cout : file;
+
+  if (!options.scaling.empty())
+  {
+    write_scaling(os, options, results, stream_bandwidth);
+  }
+  else if (options.format == "json")
+  {
+    write_json(os, results);
+  }
+  else
+  {
+    write_csv(os, results);
+  }
+
+  pmt::set_allocator(nullptr);
+
+  return 0;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "../include/common.h"
+#include "../include/misc/dimensions.h"
+#include "../include/misc/coordinate.h"
+#include "../include/parallel/thread_pool.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+NAMESPACE_PMT
+
+/*
+ * Synthetic benchmark images. Uniform noise is the worst case for the
+ * max-tree, with a node per pixel and many small block trees; the other
+ * generators are closer to natural images.
+ *
+ * noise: independent uniform values.
+ * gradient: a smooth ramp along the diagonal with a little noise.
+ * fractal: value noise summed over octaves with halving amplitudes, a 1/f
+ * spectrum like natural images.
+ * plateaus: fractal noise quantized to 8 levels, large flat zones.
+ */
+enum generator_t
+{
+  generator_noise,
+  generator_gradient,
+  generator_fractal,
+  generator_plateaus,
+  n_generators
+};
+
+inline char const* generator_name(unsigned g)
+{
+  static char const* names[n_generators] = {"noise", "gradient", "fractal", "plateaus"};
+
+  return names[g];
+}
+
+inline bool parse_generator(char const* name, generator_t* g)
+{
+  for (unsigned k = 0; k < n_generators; ++k)
+  {
+    if (strcmp(name, generator_name(k)) == 0)
+    {
+      *g = generator_t(k);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * A hash of a lattice point and seed to [0, 1)
+ */
+inline double lattice_value(uint64_t x, uint64_t y, uint64_t z, uint64_t seed)
+{
+  uint64_t h = seed;
+
+  h ^= x * 0x9E3779B97F4A7C15ULL;
+  h = (h ^ (h >> 31U)) * 0xBF58476D1CE4E5B9ULL;
+  h ^= y * 0xC2B2AE3D27D4EB4FULL;
+  h = (h ^ (h >> 29U)) * 0x94D049BB133111EBULL;
+  h ^= z * 0x165667B19E3779F9ULL;
+  h = (h ^ (h >> 32U)) * 0xD6E8FEB86659FD93ULL;
+  h ^= h >> 32U;
+
+  return double(h >> 11U) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Value noise with trilinear interpolation between lattice points that are
+ * period pixels apart
+ */
+inline double value_noise(double x, double y, double z, double period, uint64_t seed)
+{
+  x /= period;
+  y /= period;
+  z /= period;
+
+  double fx = std::floor(x);
+  double fy = std::floor(y);
+  double fz = std::floor(z);
+  uint64_t ix = uint64_t(fx);
+  uint64_t iy = uint64_t(fy);
+  uint64_t iz = uint64_t(fz);
+
+  // smoothstep weights
+  auto const& smooth = [](double t) { return t * t * (3.0 - 2.0 * t); };
+
+  double tx = smooth(x - fx);
+  double ty = smooth(y - fy);
+  double tz = smooth(z - fz);
+  double result = 0;
+
+  for (unsigned corner = 0; corner < 8U; ++corner)
+  {
+    unsigned cx = corner & 1U;
+    unsigned cy = (corner >> 1U) & 1U;
+    unsigned cz = (corner >> 2U) & 1U;
+
+    double w = (cx ? tx : 1.0 - tx) * (cy ? ty : 1.0 - ty) * (cz ? tz : 1.0 - tz);
+
+    result += w * lattice_value(ix + cx, iy + cy, iz + cz, seed);
+  }
+
+  return result;
+}
+
+/*
+ * Sum of octaves from the image size down to 2 pixels, roughly in [0, 1)
+ */
+inline double fractal_noise(double x, double y, double z, double size, uint64_t seed)
+{
+  double sum = 0;
+  double total_amplitude = 0;
+  double amplitude = 1.0;
+
+  for (double period = size; period >= 2.0; period /= 2.0)
+  {
+    sum += amplitude * value_noise(x, y, z, period, seed++);
+    total_amplitude += amplitude;
+    amplitude *= 0.5;
+  }
+
+  if (total_amplitude == 0) return 0;
+
+  // averaging octaves concentrates values around 0.5, stretch the contrast
+  return 0.5 + 2.0 * (sum / total_amplitude - 0.5);
+}
+
+/*
+ * Maps [0, 1) to the full range of integer types, and keeps floats in [0, 1)
+ */
+template <typename value_t>
+value_t scale_unit(double u)
+{
+  u = std::min(std::max(u, 0.0), std::nextafter(1.0, 0.0));
+
+  if (std::is_floating_point<value_t>::value)
+  {
+    return value_t(u);
+  }
+
+  return value_t(u * (double(std::numeric_limits<value_t>::max()) + 1.0));
+}
+
+template <typename value_t, size_t n_dimensions>
+void generate_image(
+  generator_t generator,
+  Dimensions<n_dimensions> const& dims,
+  value_t* values,
+  uint64_t seed = 1U)
+{
+  using prim = primitives<size_t, value_t, n_dimensions>;
+  using vec_t = Coordinate<prim>;
+
+  size_t n = dims.length();
+  double size = 0;
+  double diagonal = 0;
+
+  for (dim_idx_t d = 0; d < n_dimensions; ++d)
+  {
+    size = std::max(size, double(dims[d]));
+    diagonal += double(dims[d]);
+  }
+
+  thread_pool.for_all(n, [=, &dims](size_t i, thread_nr_t t) ALWAYS_INLINE {
+    vec_t c = vec_t::from_index(i, dims);
+    double x = double(c[0]);
+    double y = n_dimensions > 1 ? double(c[1 % n_dimensions]) : 0.0;
+    double z = n_dimensions > 2 ? double(c[2 % n_dimensions]) : 0.0;
+    double u = 0;
+
+    switch (generator)
+    {
+    case generator_noise:
+      u = lattice_value(i, 0, 0, seed);
+      break;
+    case generator_gradient:
+      u = 0.98 * (x + y + z) / diagonal + 0.02 * lattice_value(i, 0, 0, seed);
+      break;
+    case generator_fractal:
+      u = fractal_noise(x, y, z, size, seed);
+      break;
+    case generator_plateaus:
+      u = std::floor(fractal_noise(x, y, z, size, seed) * 8.0) / 8.0;
+      break;
+    default:
+      break;
+    }
+
+    values[i] = scale_unit<value_t>(u);
+  });
+}
+
+NAMESPACE_PMT_END
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "../include/common.h"
+#include "../include/maxtree/maxtree_stats.h"
+#include "../include/maxtree/rank_set.h"
+#include "../include/misc/edge.h"
+#include "../include/misc/unsigned_conversion.h"
+#include "../include/sort/sort_item.h"
+#include "../include/parallel/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+NAMESPACE_PMT
+
+/*
+ * Sustainable memory bandwidth in bytes/s with the active threads of the
+ * thread pool, measured with the STREAM triad a[i] = b[i] + s * c[i]. The
+ * arrays together take n_bytes, which should be well beyond the last level
+ * cache. The best of n_repeat runs is taken, as in STREAM.
+ */
+inline double stream_triad_bandwidth(size_t n_bytes, unsigned n_repeat = 5U)
+{
+  size_t n = std::max(n_bytes / (3U * sizeof(double)), size_t(1));
+  double* a = new double[n];
+  double* b = new double[n];
+  double* c = new double[n];
+
+  // first touch by the threads that use the pages
+  thread_pool.for_all(n, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  });
+
+  double best = 0;
+
+  for (unsigned r = 0; r < n_repeat; ++r)
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    thread_pool.for_all(n, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+      a[i] = b[i] + 3.0 * c[i];
+    });
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+    best = std::max(best, 3.0 * sizeof(double) * n / diff.count());
+  }
+
+  check(a[n / 2U] == 7.0);
+
+  delete[] c;
+  delete[] b;
+  delete[] a;
+
+  return best;
+}
+
+/*
+ * Estimated main memory traffic per phase in bytes, from the array sizes
+ * and edge counts of a max-tree computation. This is a model: it counts
+ * every array pass once, ignores cache reuse within image blocks, and
+ * counts a random access as the size of the element. Phases that touch
+ * little memory (estimate_quantiles, partition_offsets) get 0.
+ */
+template <typename index_t, typename value_t>
+void maxtree_phase_bytes(MaxtreeStats const& stats, double* bytes)
+{
+  using uvalue_t = decltype(unsigned_conversion(value_t(0)));
+  using edge_t = Edge<index_t>;
+  using edge_sortpair_t = SortPair<uvalue_t, edge_t>;
+  using rank_set_t = RankSet<index_t>;
+
+  double n = double(stats.n_nodes);
+  double n_reduced = double(stats.n_reduced_edges);
+  double n_exported = double(std::accumulate(
+    stats.partition_edge_counts.begin(),
+    stats.partition_edge_counts.end(),
+    size_t(0)));
+
+  std::fill(bytes, bytes + n_maxtree_phases, 0.0);
+
+  // values in, parents and block graph edges out
+  bytes[phase_reduce_edges] = n * (sizeof(value_t) + sizeof(index_t)) + n_reduced * sizeof(edge_t);
+  // values in, partition labels out
+  bytes[phase_create_partition_image] = n * (sizeof(value_t) + sizeof(partition_t));
+  // every round reads and writes the edges, and labels of both ends
+  bytes[phase_partition_graph] = double(stats.n_partition_rounds) * n_reduced *
+    (2.0 * sizeof(edge_t) + 2.0 * sizeof(partition_t));
+  // edges and the values of their first ends in, sort pairs out
+  bytes[phase_export_edges] = n_exported * (sizeof(edge_t) + sizeof(value_t) + sizeof(edge_sortpair_t));
+  // every pass of the sort that ran reads and writes all sort pairs
+  bytes[phase_sort_exported_edges] = double(stats.n_sort_digits) * n_exported * 2.0 * sizeof(edge_sortpair_t);
+  // sets are reset, then every edge visits two sets and a parent
+  bytes[phase_union_by_rank] = n * sizeof(rank_set_t) +
+    n_exported * (sizeof(edge_t) + 2.0 * sizeof(rank_set_t) + sizeof(index_t));
+}
+
+NAMESPACE_PMT_END
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/bits.h"
+#include "../parallel/thread_pool.h"
+#include "euler_tour.h"
+#include <algorithm>
+
+NAMESPACE_PMT
+
+template <typename Index>
+class AncestorIndex;
+
+template <typename index_t>
+void ancestor_index(
+  index_t* parents,
+  size_t n,
+  AncestorIndex<index_t>* out,
+  unsigned max_levels = 32U);
+
+/*
+ * Query index for level ancestors and lowest common ancestors. jump(k, x) is
+ * the ancestor 2^k edges above x (or the root). Only max_levels levels of
+ * jump pointers are stored, so the memory use is n * max_levels indices plus
+ * the Euler tour. Jumps of more than 2^(max_levels - 1) edges repeat the top
+ * level, so queries take O(depth / 2^(max_levels - 1) + max_levels) steps.
+ */
+template <typename Index>
+class AncestorIndex
+{
+public:
+  using index_t = Index;
+
+  static constexpr index_t none = ~index_t(0);
+
+  AncestorIndex() {}
+  AncestorIndex(AncestorIndex const&) = delete;
+  AncestorIndex& operator=(AncestorIndex const&) = delete;
+
+  ~AncestorIndex()
+  {
+    clear();
+  }
+
+  size_t n() const { return tour_.n(); }
+  unsigned n_levels() const { return n_levels_; }
+  EulerTour<index_t> const& tour() const { return tour_; }
+
+  index_t jump(unsigned k, index_t x) const
+  {
+    return jumps_[size_t(k) * n() + x];
+  }
+
+  /*
+   * The ancestor d edges above x, or none if x is less deep
+   */
+  index_t ancestor(index_t x, index_t d) const;
+
+  /*
+   * The largest component containing x with a level of at least v: the
+   * highest ancestor with a value of at least v, or none if values[x] < v
+   */
+  template <typename value_t>
+  index_t ancestor_at_level(index_t x, value_t const* values, value_t const& v) const;
+
+  index_t lowest_common_ancestor(index_t a, index_t b) const;
+
+  /*
+   * Batched queries, in parallel
+   */
+  void ancestors(index_t const* xs, index_t const* ds, size_t m, index_t* out) const;
+
+  template <typename value_t>
+  void ancestors_at_levels(
+    index_t const* xs,
+    value_t const* values,
+    value_t const* vs,
+    size_t m,
+    index_t* out) const;
+
+  void lowest_common_ancestors(index_t const* as, index_t const* bs, size_t m, index_t* out) const;
+
+  template <typename I>
+  friend void ancestor_index(I* parents, size_t n, AncestorIndex<I>* out, unsigned max_levels);
+
+private:
+  void clear()
+  {
+    delete[] jumps_;
+    jumps_ = nullptr;
+    n_levels_ = 0;
+  }
+
+  EulerTour<index_t> tour_;
+  unsigned n_levels_ = 0;
+  index_t* jumps_ = nullptr;
+};
+
+template <typename index_t>
+index_t AncestorIndex<index_t>::ancestor(index_t x, index_t d) const
+{
+  if (d > tour_.depth(x)) return none;
+
+  unsigned top = n_levels_ - 1U;
+  index_t top_length = index_t(1) << top;
+
+  while (d >= top_length)
+  {
+    x = jump(top, x);
+    d -= top_length;
+  }
+
+  for (unsigned k = 0; d != 0; ++k, d >>= 1U)
+  {
+    if (d & 1U)
+    {
+      x = jump(k, x);
+    }
+  }
+
+  return x;
+}
+
+template <typename index_t>
+template <typename value_t>
+index_t AncestorIndex<index_t>::ancestor_at_level(
+  index_t x,
+  value_t const* values,
+  value_t const& v) const
+{
+  if (values[x] < v) return none;
+
+  unsigned top = n_levels_ - 1U;
+
+  // values do not increase towards the root
+  for (index_t y = jump(top, x); y != x && !(values[y] < v); y = jump(top, x))
+  {
+    x = y;
+  }
+
+  for (unsigned k = top; k--;)
+  {
+    index_t y = jump(k, x);
+
+    if (!(values[y] < v))
+    {
+      x = y;
+    }
+  }
+
+  return x;
+}
+
+template <typename index_t>
+index_t AncestorIndex<index_t>::lowest_common_ancestor(index_t a, index_t b) const
+{
+  if (tour_.is_ancestor(a, b)) return a;
+  if (tour_.is_ancestor(b, a)) return b;
+
+  unsigned top = n_levels_ - 1U;
+
+  // climb to the highest ancestor of a that is not an ancestor of b
+  for (index_t y = jump(top, a); !tour_.is_ancestor(y, b); y = jump(top, a))
+  {
+    a = y;
+  }
+
+  for (unsigned k = top; k--;)
+  {
+    index_t y = jump(k, a);
+
+    if (!tour_.is_ancestor(y, b))
+    {
+      a = y;
+    }
+  }
+
+  return jump(0, a);
+}
+
+template <typename index_t>
+void AncestorIndex<index_t>::ancestors(
+  index_t const* xs,
+  index_t const* ds,
+  size_t m,
+  index_t* out) const
+{
+  thread_pool.for_all(m, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+    out[i] = ancestor(xs[i], ds[i]);
+  });
+}
+
+template <typename index_t>
+template <typename value_t>
+void AncestorIndex<index_t>::ancestors_at_levels(
+  index_t const* xs,
+  value_t const* values,
+  value_t const* vs,
+  size_t m,
+  index_t* out) const
+{
+  thread_pool.for_all(m, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+    out[i] = ancestor_at_level(xs[i], values, vs[i]);
+  });
+}
+
+template <typename index_t>
+void AncestorIndex<index_t>::lowest_common_ancestors(
+  index_t const* as,
+  index_t const* bs,
+  size_t m,
+  index_t* out) const
+{
+  thread_pool.for_all(m, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+    out[i] = lowest_common_ancestor(as[i], bs[i]);
+  });
+}
+
+/*
+ * Builds the Euler tour and the jump pointers, one level per parallel pass.
+ * At most max_levels levels are stored, and no more than needed for the
+ * depth of the tree.
+ */
+template <typename index_t>
+void ancestor_index(
+  index_t* parents,
+  size_t n,
+  AncestorIndex<index_t>* out,
+  unsigned max_levels)
+{
+  check(max_levels >= 1U);
+
+  out->clear();
+
+  euler_tour(parents, n, &out->tour_);
+
+  if (n == 0) return;
+
+  unsigned needed = pmt::log2(size_t(out->tour_.max_depth()) | 1U) + 1U;
+  unsigned n_levels = std::min(needed, max_levels);
+
+  out->n_levels_ = n_levels;
+  out->jumps_ = new index_t[size_t(n_levels) * n];
+
+  index_t* jumps = out->jumps_;
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    jumps[i] = parents[i];
+  });
+
+  for (unsigned k = 1; k < n_levels; ++k)
+  {
+    index_t const* previous = jumps + size_t(k - 1U) * n;
+    index_t* current = jumps + size_t(k) * n;
+
+    thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+      current[i] = previous[previous[i]];
+    });
+  }
+}
+
+NAMESPACE_PMT_END
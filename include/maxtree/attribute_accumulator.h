@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../common.h"
+#include "../parallel/thread_pool.h"
+#include "../misc/memory_tracker.h"
+#include "tree_scan.h"
+
+NAMESPACE_PMT
+
+/*
+ * Accumulator used by Maxtree if no attributes are computed during
+ * construction. All operations are removed at compile time.
+ */
+template <typename Index>
+struct NoAttributes
+{
+  using index_t = Index;
+
+  static constexpr bool enabled = false;
+
+  INLINE void init(index_t i) const {}
+  INLINE void merge(index_t a, index_t b) const {}
+  void scan(index_t* parents, index_t const* nodes, size_t n) const {}
+};
+
+/*
+ * Accumulates an associative and commutative attribute while the max-tree
+ * is constructed, so that a separate tree_scan over all nodes is not needed.
+ * w(i) gives the initial attribute of element i, and plus(a, b) merges the
+ * attributes of pixel set b to pixel set a.
+ */
+template <
+  typename Index,
+  typename Attribute,
+  typename Functor1,
+  typename Functor2>
+struct AttributeAccumulator : ScanLane<Index, Attribute, Functor1, Functor2>
+{
+  using lane_t = ScanLane<Index, Attribute, Functor1, Functor2>;
+  using index_t = Index;
+  using attribute_t = Attribute;
+
+  static constexpr bool enabled = true;
+
+  using lane_t::lane_t;
+
+  /*
+   * Finish the attributes of the nodes in a (compacted) subtree.
+   * parents refers to positions in nodes, and the current attribute of a node
+   * is the partial attribute, without the attributes of its children in the
+   * subtree.
+   */
+  void scan(index_t* parents, index_t const* nodes, size_t n) const
+  {
+    if (n <= 1) return;
+
+    attribute_t* RESTRICT attributes = this->attributes_;
+    attribute_t* RESTRICT compact = tracked_new<attribute_t>(n);
+
+    auto const& w = [=](index_t i) ALWAYS_INL_L(attribute_t)
+    {
+      return attributes[nodes[i]];
+    };
+
+    tree_scan(parents, n, compact, w, this->plus_);
+
+    thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+      attributes[nodes[i]] = compact[i];
+    });
+
+    tracked_delete(compact, n);
+  }
+};
+
+NAMESPACE_PMT_END
@@ -83,6 +83,8 @@ ConnectedComponents<index_t, value_t>::ConnectedComponents(
   roots_(roots),
   select_(n_edges, block_length)
 {
+  PMT_TRACE_SCOPE("ConnectedComponents");
+
   typename rng<index_t>::type r;    
 
   total_compacted_ = 0;
@@ -2,6 +2,10 @@
 
 #include "../common.h"
 #include "graph.h"
+#include "../misc/exclusive_sum.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
 
 NAMESPACE_PMT
 
@@ -42,6 +46,14 @@ private:
   // n_samples = n_samples_factor * n_partitions^2
   static constexpr size_t n_samples_factor = 384U;
 
+  // values of at most 16 bits are counted instead of sampled
+  static constexpr bool use_histogram = sizeof(uvalue_t) <= 2U;
+  static constexpr size_t n_bins =
+    use_histogram ? size_t(1) << (sizeof(uvalue_t) * CHAR_BIT) : 0;
+
+  // the edges counted in one 32 bit histogram
+  static constexpr size_t max_range_edges = std::numeric_limits<uint32_t>::max();
+
   EstimateQuantiles(
     graph_t const& graph,
     value_t const* values,
@@ -52,6 +64,8 @@ private:
 
   ~EstimateQuantiles();
 
+  void histogram_quantiles();
+  void break_ties(uvalue_t const* bounds, size_t const* ties, size_t const* histo);
   sort_pair_t* sort_everything();
   sort_pair_t* create_sorted_sample();
 
@@ -98,6 +112,13 @@ EstimateQuantiles<index_t, value_t>::EstimateQuantiles(
 {
   size_t n_edges = graph.n_edges();
   check(n_edges > 0);
+
+  if (use_histogram)
+  {
+    histogram_quantiles();
+    return;
+  }
+
   size_t n_subgraphs = graph.n_subgraphs();
   n_selected_ = new size_t[2U * n_subgraphs];
   offsets_ = n_selected_ + n_subgraphs;
@@ -124,6 +145,227 @@ EstimateQuantiles<index_t, value_t>::~EstimateQuantiles()
   delete[] n_selected_;
 }
 
+/*
+ * Exact quantiles of the edges, ordered by the value and index of their
+ * node a_, from a histogram of the values. The edges are split in ranges
+ * of at most max_range_edges, with a histogram of 32 bit counts each, which
+ * cannot overflow. There are at most one histogram per thread and only as
+ * many as fit in the memory budget, and if there are more ranges, they are
+ * counted in rounds. The partitions get the same number of edges, up to
+ * edges with the same a_.
+ */
+template <typename index_t, typename value_t>
+void EstimateQuantiles<index_t, value_t>::histogram_quantiles()
+{
+  size_t n_edges = graph_.n_edges();
+  size_t n_subgraphs = graph_.n_subgraphs();
+  size_t n_histos = std::max<size_t>(1U, std::min<size_t>(thread_pool.max_threads(), n_subgraphs));
+
+  while (n_histos > 1U && !memory_tracker.fits(n_histos * n_bins * sizeof(uint32_t)))
+  {
+    n_histos /= 2U;
+  }
+
+  size_t range_length = std::min(div_roundup(n_edges, n_histos), max_range_edges);
+  size_t n_ranges = div_roundup(n_edges, range_length);
+  uint32_t* histos = tracked_new<uint32_t>(n_histos * n_bins);
+  size_t* totals = new size_t[n_bins];
+  // subgraph_ends[s] is the number of edges in subgraphs 0 ... s
+  size_t* subgraph_ends = new size_t[n_subgraphs];
+  graph_t const& graph = graph_;
+  value_t const* values = values_;
+  size_t total_edges = 0;
+
+  for (size_t s = 0; s < n_subgraphs; ++s)
+  {
+    total_edges += graph.edge_count(s);
+    subgraph_ends[s] = total_edges;
+  }
+
+  std::fill(totals, totals + n_bins, size_t(0));
+
+  // a block of bins per thread
+  size_t n_bins_per_block = std::max<size_t>(256U, div_roundup(n_bins, thread_pool.max_threads()));
+
+  for (size_t first_range = 0; first_range < n_ranges; first_range += n_histos)
+  {
+    size_t n_round = std::min(n_histos, n_ranges - first_range);
+
+    thread_pool.for_all_blocks(n_round, [=, &graph](size_t h, thread_nr_t t) {
+      uint32_t* histo = histos + h * n_bins;
+      size_t begin = (first_range + h) * range_length;
+      size_t end = std::min(begin + range_length, n_edges);
+      size_t s = std::upper_bound(subgraph_ends, subgraph_ends + n_subgraphs, begin) - subgraph_ends;
+
+      std::fill(histo, histo + n_bins, uint32_t(0));
+
+      for (; begin < end; ++s)
+      {
+        size_t subgraph_begin = subgraph_ends[s] - graph.edge_count(s);
+        size_t i_end = std::min(end, subgraph_ends[s]) - subgraph_begin;
+        edge_t const* edges = graph.subgraph(s);
+
+        for (size_t i = begin - subgraph_begin; i != i_end; ++i)
+        {
+          ++histo[unsigned_conversion(values[edges[i].a_])];
+        }
+
+        begin = subgraph_begin + i_end;
+      }
+    });
+
+    thread_pool.for_all(n_bins, [=](size_t b, thread_nr_t t) ALWAYS_INLINE {
+      size_t total = totals[b];
+
+      for (size_t h = 0; h < n_round; ++h)
+      {
+        total += histos[h * n_bins + b];
+      }
+
+      totals[b] = total;
+    }, n_bins_per_block);
+  }
+
+  delete[] subgraph_ends;
+  tracked_delete(histos, n_histos * n_bins);
+
+  quantiles_[0] = {std::numeric_limits<value_t>::min(), index_t(0)};
+
+  // quantile i has value bounds[i], and ties[i] edges with that value before it
+  uvalue_t* bounds = new uvalue_t[n_partitions_];
+  size_t* ties = new size_t[n_partitions_];
+  size_t below = 0;
+  size_t b = 0;
+
+  for (size_t i = 1; i < n_partitions_; ++i)
+  {
+    size_t rank = i * n_edges / n_partitions_;
+
+    while (below + totals[b] <= rank)
+    {
+      below += totals[b++];
+    }
+
+    bounds[i] = uvalue_t(b);
+    ties[i] = rank - below;
+  }
+
+  break_ties(bounds, ties, totals);
+
+  delete[] ties;
+  delete[] bounds;
+  delete[] totals;
+}
+
+/*
+ * Sets the quantiles from their values and their ranks among the edges
+ * with the same value. The nodes a_ of the edges with a quantile value are
+ * gathered in aux1, and the node of quantile i is the ties[i]-th smallest
+ * node of its value.
+ */
+template <typename index_t, typename value_t>
+void EstimateQuantiles<index_t, value_t>::break_ties(
+  uvalue_t const* bounds,
+  size_t const* ties,
+  size_t const* histo)
+{
+  // groups[v] is 1 + the group of the quantiles with value v, or 0
+  uint16_t* groups = new uint16_t[n_bins];
+  size_t* first_quantiles = new size_t[n_partitions_];
+  size_t n_groups = 0;
+
+  std::fill(groups, groups + n_bins, uint16_t(0));
+
+  for (size_t i = 1; i < n_partitions_; ++i)
+  {
+    if (groups[bounds[i]] == 0)
+    {
+      first_quantiles[n_groups++] = i;
+      groups[bounds[i]] = uint16_t(n_groups);
+    }
+  }
+
+  first_quantiles[n_groups] = n_partitions_;
+
+  size_t* group_begins = new size_t[n_groups + 1U];
+  std::atomic<size_t>* group_ends = new std::atomic<size_t>[n_groups];
+
+  for (size_t g = 0; g < n_groups; ++g)
+  {
+    group_begins[g] = histo[bounds[first_quantiles[g]]];
+  }
+
+  exclusive_sum(group_begins, group_begins + n_groups + 1U);
+
+  for (size_t g = 0; g < n_groups; ++g)
+  {
+    group_ends[g] = group_begins[g];
+  }
+
+  size_t* counts = new size_t[thread_pool.max_threads() * n_groups];
+  index_t* nodes = static_cast<index_t*>(aux1_);
+  graph_t const& graph = graph_;
+  value_t const* values = values_;
+
+  thread_pool.for_all_blocks(graph.n_subgraphs(), [=, &graph](size_t subgraph_nr, thread_nr_t t) {
+    size_t* count = counts + t * n_groups;
+    edge_t const* edges = graph.subgraph(subgraph_nr);
+    size_t n_edges_in_subgraph = graph.edge_count(subgraph_nr);
+
+    std::fill(count, count + n_groups, size_t(0));
+
+    for (size_t i = 0; i != n_edges_in_subgraph; ++i)
+    {
+      uint16_t g = groups[unsigned_conversion(values[edges[i].a_])];
+
+      if (g > 0)
+      {
+        ++count[g - 1U];
+      }
+    }
+
+    // reserve the space of this subgraph in every group
+    for (size_t g = 0; g < n_groups; ++g)
+    {
+      count[g] = group_ends[g].fetch_add(count[g]);
+    }
+
+    for (size_t i = 0; i != n_edges_in_subgraph; ++i)
+    {
+      uint16_t g = groups[unsigned_conversion(values[edges[i].a_])];
+
+      if (g > 0)
+      {
+        nodes[count[g - 1U]++] = edges[i].a_;
+      }
+    }
+  });
+
+  thread_pool.for_all_blocks(n_groups, [=](size_t g, thread_nr_t t) {
+    index_t* begin = nodes + group_begins[g];
+    index_t* end = nodes + group_begins[g + 1U];
+    index_t* from = begin;
+
+    for (size_t i = first_quantiles[g]; i < first_quantiles[g + 1U]; ++i)
+    {
+      index_t* nth = begin + ties[i];
+      value_t v;
+
+      std::nth_element(from, nth, end);
+      undo_unsigned_conversion(bounds[i], v);
+
+      quantiles_[i] = {v, *nth};
+      from = nth;
+    }
+  });
+
+  delete[] counts;
+  delete[] group_ends;
+  delete[] group_begins;
+  delete[] first_quantiles;
+  delete[] groups;
+}
+
 template <typename index_t, typename value_t>
 typename EstimateQuantiles<index_t, value_t>::sort_pair_t*
 EstimateQuantiles<index_t, value_t>::sort_everything()
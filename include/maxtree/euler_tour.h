@@ -0,0 +1,322 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/bits.h"
+#include "../misc/edge.h"
+#include "../parallel/thread_pool.h"
+#include "../sort/sort_item.h"
+#include "../sort/radix_sort_parallel.h"
+#include "tree_scan.h"
+#include "rootfix.h"
+#include "topological_order.h"
+#include <algorithm>
+
+NAMESPACE_PMT
+
+/*
+ * A materialized Euler tour: the nodes in pre-order, where children are
+ * visited in index order. The subtree of node x is node(entry(x)) ...
+ * node(exit(x) - 1), so subtree queries are range queries over contiguous
+ * arrays.
+ */
+template <typename Index>
+class EulerTour
+{
+public:
+  using index_t = Index;
+
+  EulerTour() {}
+  EulerTour(EulerTour const&) = delete;
+  EulerTour& operator=(EulerTour const&) = delete;
+
+  ~EulerTour()
+  {
+    clear();
+  }
+
+  size_t n() const { return n_; }
+  index_t max_depth() const { return max_depth_; }
+
+  index_t entry(index_t x) const { return entries_[x]; }
+  index_t exit(index_t x) const { return exits_[x]; }
+  index_t node(index_t k) const { return preorder_[k]; }
+  index_t depth(index_t x) const { return depths_[x]; }
+  index_t subtree_size(index_t x) const { return exits_[x] - entries_[x]; }
+
+  index_t const* entries() const { return entries_; }
+  index_t const* exits() const { return exits_; }
+  index_t const* preorder() const { return preorder_; }
+  index_t const* depths() const { return depths_; }
+
+  /*
+   * True if a is x or an ancestor of x
+   */
+  bool is_ancestor(index_t a, index_t x) const
+  {
+    return entries_[a] <= entries_[x] && entries_[x] < exits_[a];
+  }
+
+  /*
+   * Number of descendants of x that are relative_depth edges below x
+   */
+  size_t count_descendants_at_depth(index_t x, index_t relative_depth) const;
+
+  template <typename I>
+  friend void euler_tour(I* parents, size_t n, EulerTour<I>* out);
+
+private:
+  void allocate(size_t n);
+  void clear();
+  void index_depths();
+
+  size_t n_ = 0;
+  index_t max_depth_ = 0;
+  index_t* entries_ = nullptr;
+  index_t* exits_ = nullptr;
+  index_t* preorder_ = nullptr;
+  index_t* depths_ = nullptr;
+  // entries sorted by depth, then by entry
+  index_t* by_depth_ = nullptr;
+  index_t* depth_offsets_ = nullptr;
+};
+
+template <typename index_t>
+void EulerTour<index_t>::allocate(size_t n)
+{
+  clear();
+
+  n_ = n;
+  entries_ = new index_t[n];
+  exits_ = new index_t[n];
+  preorder_ = new index_t[n];
+  depths_ = new index_t[n];
+  by_depth_ = new index_t[n];
+}
+
+template <typename index_t>
+void EulerTour<index_t>::clear()
+{
+  delete[] entries_;
+  delete[] exits_;
+  delete[] preorder_;
+  delete[] depths_;
+  delete[] by_depth_;
+  delete[] depth_offsets_;
+  entries_ = exits_ = preorder_ = depths_ = by_depth_ = depth_offsets_ = nullptr;
+  n_ = 0;
+  max_depth_ = 0;
+}
+
+template <typename index_t>
+size_t EulerTour<index_t>::count_descendants_at_depth(
+  index_t x,
+  index_t relative_depth) const
+{
+  size_t depth = size_t(depths_[x]) + relative_depth;
+
+  if (depth > max_depth_) return 0;
+
+  index_t const* begin = by_depth_ + depth_offsets_[depth];
+  index_t const* end = by_depth_ + depth_offsets_[depth + 1U];
+
+  return std::lower_bound(begin, end, exits_[x]) -
+    std::lower_bound(begin, end, entries_[x]);
+}
+
+/*
+ * Sorts the entries by depth. The input is in pre-order and the sort is
+ * stable, so entries of the same depth stay sorted.
+ */
+template <typename index_t>
+void EulerTour<index_t>::index_depths()
+{
+  using item_t = SortPair<index_t, index_t>;
+
+  index_t* depths = depths_;
+  index_t* preorder = preorder_;
+  index_t* by_depth = by_depth_;
+  size_t n = n_;
+
+  max_depth_ = pmt::max_depth(depths, n);
+
+  size_t n_depths = size_t(max_depth_) + 1U;
+
+  depth_offsets_ = new index_t[n_depths + 1U];
+
+  index_t* depth_offsets = depth_offsets_;
+
+  if (n == 1)
+  {
+    by_depth[0] = 0;
+  }
+  else
+  {
+    item_t* aux1 = new item_t[n];
+    item_t* aux2 = new item_t[n];
+
+    auto const& f_initial = [=](size_t k) ALWAYS_INL_L(item_t)
+    {
+      return {depths[preorder[k]], index_t(k)};
+    };
+
+    auto const& f_out = [=](index_t& out, item_t const& item) ALWAYS_INLINE
+    {
+      out = item.data();
+    };
+
+    unsigned n_bits = pmt::log2(size_t(max_depth_) | 1U) + 1U;
+
+    radix_sort_parallel(by_depth, aux1, aux2, n, 0U, n_bits, f_initial, f_out);
+
+    delete[] aux2;
+    delete[] aux1;
+  }
+
+  // every depth up to the maximum occurs
+  thread_pool.for_all(n, [=](index_t k, thread_nr_t t) ALWAYS_INLINE {
+    index_t depth = depths[preorder[by_depth[k]]];
+
+    if (k == 0 || depths[preorder[by_depth[k - 1U]]] != depth)
+    {
+      depth_offsets[depth] = k;
+    }
+  });
+
+  depth_offsets[n_depths] = n;
+}
+
+/*
+ * Constructs the Euler tour in parallel. The entry of a node is the entry of
+ * its parent, plus one, plus the sizes of its preceding siblings. The sibling
+ * offsets are prefix sums over the edges sorted by parent, and the entries
+ * are the sums of the offsets along the path to the root (rootfix).
+ */
+template <typename index_t>
+void euler_tour(index_t* parents, size_t n, EulerTour<index_t>* out)
+{
+  using edge_t = SortableEdgeByStart<index_t>;
+
+  out->allocate(n);
+
+  if (n == 0) return;
+
+  index_t* entries = out->entries_;
+  index_t* exits = out->exits_;
+  index_t* preorder = out->preorder_;
+
+  node_depths(parents, n, out->depths_);
+
+  // subtree sizes
+  {
+    auto const& w = [](index_t i) ALWAYS_INL_L(index_t)
+    {
+      return 1U;
+    };
+
+    auto const& plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t)
+    {
+      return a + b;
+    };
+
+    tree_scan(parents, n, exits, w, plus);
+  }
+
+  index_t* offsets = new index_t[n];
+
+  if (n == 1)
+  {
+    offsets[0] = 0;
+  }
+  else
+  {
+    edge_t* aux1 = new edge_t[n];
+    edge_t* aux2 = new edge_t[n];
+
+    // the root is last
+    auto const& f_initial_item = [=](index_t i) ALWAYS_INL_L(edge_t)
+    {
+      return {parents[i] == i ? ~index_t(0) : parents[i], i};
+    };
+
+    edge_t* edges = radix_sort_parallel(aux1, aux2, n, f_initial_item);
+    size_t n_edges = n - 1U;
+
+    // exclusive prefix sums of the subtree sizes, in edge order
+    index_t* prefix = preorder;
+    size_t n_chunks = div_roundup(n_edges, default_n_items_per_block);
+    index_t* chunk_sums = new index_t[n_chunks + 1U];
+
+    thread_pool.for_all_blocks(n_chunks, [=](size_t c, thread_nr_t t) {
+      size_t begin = c * default_n_items_per_block;
+      size_t end = std::min(begin + default_n_items_per_block, n_edges);
+      index_t sum = 0;
+
+      for (; begin != end; ++begin)
+      {
+        sum += exits[edges[begin].b_];
+      }
+
+      chunk_sums[c] = sum;
+    });
+
+    exclusive_sum(chunk_sums, chunk_sums + n_chunks + 1U);
+
+    thread_pool.for_all_blocks(n_chunks, [=](size_t c, thread_nr_t t) {
+      size_t begin = c * default_n_items_per_block;
+      size_t end = std::min(begin + default_n_items_per_block, n_edges);
+      index_t sum = chunk_sums[c];
+
+      for (; begin != end; ++begin)
+      {
+        prefix[begin] = sum;
+        sum += exits[edges[begin].b_];
+      }
+    });
+
+    delete[] chunk_sums;
+
+    // prefix sum at the first child of every node
+    index_t* first_prefix = entries;
+
+    thread_pool.for_all(n_edges, [=](index_t j, thread_nr_t t) ALWAYS_INLINE {
+      if (j == 0 || edges[j - 1U].a_ != edges[j].a_)
+      {
+        first_prefix[edges[j].a_] = prefix[j];
+      }
+    });
+
+    thread_pool.for_all(n, [=](index_t j, thread_nr_t t) ALWAYS_INLINE {
+      edge_t const& edge = edges[j];
+
+      offsets[edge.b_] = j == n_edges ? 0 : 1U + prefix[j] - first_prefix[edge.a_];
+    });
+
+    delete[] aux2;
+    delete[] aux1;
+  }
+
+  {
+    auto const& w = [=](index_t i) ALWAYS_INL_L(index_t)
+    {
+      return offsets[i];
+    };
+
+    auto const& plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t)
+    {
+      return a + b;
+    };
+
+    rootfix(parents, n, entries, w, plus);
+  }
+
+  delete[] offsets;
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    exits[i] += entries[i];
+    preorder[entries[i]] = i;
+  });
+
+  out->index_depths();
+}
+
+NAMESPACE_PMT_END
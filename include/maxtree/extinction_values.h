@@ -0,0 +1,160 @@
+#pragma once
+
+#include "../common.h"
+#include "../parallel/thread_pool.h"
+#include "tree_scan.h"
+#include "nearest_ancestor.h"
+#include <atomic>
+
+NAMESPACE_PMT
+
+/*
+ * Extinction values of an increasing attribute, computed on the canonical
+ * tree of the level roots. Every level root keeps its dominant child: the
+ * child level root with the largest attribute, or the largest index if
+ * attributes are equal. The dominant leaf of a node is found by following
+ * dominant children, and the maximum it represents goes extinct at the
+ * highest ancestor that is reached along dominant children only.
+ *
+ * Writes, for every node, the attribute of that highest ancestor to
+ * extinction. For a regional maximum (a level root without child level
+ * roots) this is its extinction value; other nodes get the extinction value
+ * of their dominant leaf. If dominant_leaves is not null, it receives the
+ * dominant leaf of every node. The root is never dominated, so the highest
+ * maximum gets the attribute of the root.
+ *
+ * Dominant children are chosen with compare-and-swap per parent, and the
+ * highest ancestors are nearest marked ancestors (rootfix).
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename attribute_t>
+void extinction_values(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  attribute_t const* attributes,
+  attribute_t* extinction,
+  index_t* dominant_leaves = nullptr)
+{
+  constexpr index_t none = ~index_t(0);
+
+  index_t* level_roots = new index_t[n];
+  index_t* tops = new index_t[n];
+  std::atomic<index_t>* dominant = new std::atomic<index_t>[n];
+
+  key_roots(parents, n, [=](index_t i) ALWAYS_INL_L(value_t) { return values[i]; }, level_roots);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    dominant[i].store(none, std::memory_order_relaxed);
+  });
+
+  auto const& is_canonical = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return level_roots[i] == i;
+  };
+
+  auto const& dominates = [=](index_t a, index_t b) ALWAYS_INL_L(bool)
+  {
+    return b == none ||
+      attributes[a] > attributes[b] ||
+      (!(attributes[b] > attributes[a]) && a > b);
+  };
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    if (!is_canonical(i) || parents[i] == i) return;
+
+    std::atomic<index_t>& best = dominant[level_roots[parents[i]]];
+    index_t current = best.load(std::memory_order_relaxed);
+
+    while (dominates(i, current) &&
+      !best.compare_exchange_weak(current, i, std::memory_order_relaxed))
+    {
+    }
+  });
+
+  // non-canonical nodes are never marked, so they share the top of their level root
+  auto const& marked = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return is_canonical(i) &&
+      dominant[level_roots[parents[i]]].load(std::memory_order_relaxed) != i;
+  };
+
+  nearest_marked_ancestor(parents, n, marked, tops);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    extinction[i] = attributes[tops[i]];
+  });
+
+  if (dominant_leaves != nullptr)
+  {
+    // exactly one leaf ends every dominant chain
+    index_t* leaf_of_top = new index_t[n];
+
+    thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+      bool leaf = is_canonical(i) && dominant[i].load(std::memory_order_relaxed) == none;
+
+      if (leaf)
+      {
+        leaf_of_top[tops[i]] = i;
+      }
+    });
+
+    thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+      dominant_leaves[i] = leaf_of_top[tops[i]];
+    });
+
+    delete[] leaf_of_top;
+  }
+
+  delete[] dominant;
+  delete[] tops;
+  delete[] level_roots;
+}
+
+/*
+ * Dynamics: extinction values of the height attribute, the difference
+ * between the highest value in the component of a level root and the value
+ * of its parent. The dynamics of a regional maximum is the depth of the
+ * valley to a higher maximum; the highest maximum gets its difference with
+ * the root level.
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename attribute_t>
+void dynamics(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  attribute_t* extinction,
+  index_t* dominant_leaves = nullptr)
+{
+  value_t* highest = new value_t[n];
+  attribute_t* heights = new attribute_t[n];
+
+  auto const& w = [=](index_t i) ALWAYS_INL_L(value_t)
+  {
+    return values[i];
+  };
+
+  auto const& max = [](value_t a, value_t b) ALWAYS_INL_L(value_t)
+  {
+    return std::max(a, b);
+  };
+
+  tree_scan(parents, n, highest, w, max);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    heights[i] = attribute_t(highest[i]) - attribute_t(values[parents[i]]);
+  });
+
+  delete[] highest;
+
+  extinction_values(parents, n, values, heights, extinction, dominant_leaves);
+
+  delete[] heights;
+}
+
+NAMESPACE_PMT_END
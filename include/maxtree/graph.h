@@ -8,6 +8,7 @@
 #include "../misc/quantile.h"
 #include "../sort/radix_sort_parallel.h"
 #include "../misc/unsigned_conversion.h"
+#include "../misc/memory_tracker.h"
 
 NAMESPACE_PMT
 
@@ -104,14 +105,14 @@ Graph<index_t>::Graph(size_t n_subgraphs, size_t max_nodes, size_t max_edges) :
   local_edge_counts_ = subgraph_offsets_ + n_subgraphs + 1U;
   global_edge_counts_ = local_edge_counts_ + n_subgraphs + 1U;
 
-  edges_ = new edge_t[max_edges];
+  edges_ = tracked_new<edge_t>(max_edges);
 }
 
 template <typename index_t>
 Graph<index_t>::~Graph()
 {
   delete[] subgraph_offsets_;
-  delete[] edges_;
+  tracked_delete(edges_, max_edges_);
 }
 
 template <typename index_t>
@@ -21,7 +21,8 @@ void partition_graph(
   size_t max_partitions,
   size_t* total_partition_counts,
   Edge<typename prim::index_t>* aux1,
-  Edge<typename prim::index_t>* aux2)
+  Edge<typename prim::index_t>* aux2,
+  size_t* n_rounds = nullptr)
 {
   GraphPartitioning<prim> gp(
     ib,
@@ -32,6 +33,11 @@ void partition_graph(
     total_partition_counts,
     aux1,
     aux2);
+
+  if (n_rounds != nullptr)
+  {
+    *n_rounds = gp.n_rounds_;
+  }
 }
 
 template <typename Primitives>
@@ -55,7 +61,8 @@ private:
   size_t max_partitions,
   size_t* total_partition_counts,
   Edge<typename prim::index_t>* aux1,
-  Edge<typename prim::index_t>* aux2);
+  Edge<typename prim::index_t>* aux2,
+  size_t* n_rounds);
 
 
   GraphPartitioning(
@@ -99,6 +106,7 @@ private:
   size_t* edges11_offsets_;
   index_t* roots_ = nullptr;
   size_t* partition_counts_per_subgraph_;
+  size_t n_rounds_ = 0;
   bool completed_;
 
 #ifdef PMT_DEBUG
@@ -130,6 +138,8 @@ GraphPartitioning<prim>::GraphPartitioning(
 
   if (completed_) return;
 
+  PMT_TRACE_SCOPE("GraphPartitioning");
+
   size_t n_subgraphs = graph_.n_subgraphs();
 
   aux_subgraph_offsets_ = new size_t[5U * (n_subgraphs + 1U)];
@@ -137,7 +147,7 @@ GraphPartitioning<prim>::GraphPartitioning(
   edges11_counts_ = edges01_counts_ + n_subgraphs + 1U;
   edges01_offsets_ = edges11_counts_ + n_subgraphs + 1U;
   edges11_offsets_ = edges01_offsets_ + n_subgraphs + 1U;
-  roots_ = new index_t[graph_.max_nodes()];
+  roots_ = tracked_new<index_t>(graph_.max_nodes());
 
 #ifdef PMT_DEBUG
   checksums_ = new size_t[n_subgraphs + 1U];
@@ -156,6 +166,7 @@ GraphPartitioning<prim>::GraphPartitioning(
   while (!completed())
   {
     partition();
+    ++n_rounds_;
   }
 
   // determine_partition_counts(total_partition_counts);
@@ -164,7 +175,7 @@ GraphPartitioning<prim>::GraphPartitioning(
 template <typename prim>
 GraphPartitioning<prim>::~GraphPartitioning()
 {
-  delete[] roots_;
+  tracked_delete(roots_, graph_.max_nodes());
   delete[] aux_subgraph_offsets_;
 
 #ifdef PMT_DEBUG
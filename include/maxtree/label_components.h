@@ -0,0 +1,373 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/edge.h"
+#include "../misc/exclusive_sum.h"
+#include "../image/image_blocks.h"
+#include "../parallel/thread_pool.h"
+#include "connected_components.h"
+#include <algorithm>
+#include <vector>
+
+NAMESPACE_PMT
+
+template <typename Primitives, typename Predicate>
+class LabelComponents;
+
+/*
+ * Labels the connected components of an image. Two neighboring pixels are
+ * connected if connected(values[p], values[q]) is true, so the predicate
+ * must be symmetric. Every pixel gets the component root: the pixel with
+ * minimal tuple (values[x], x) in its component, as in
+ * connected_components. For binary images, use a predicate that is only
+ * true if both values are foreground; background pixels then form
+ * single-pixel components.
+ *
+ * Every image block is labelled sequentially with union-find, and the edges
+ * that cross block boundaries are contracted with connected_components.
+ */
+template <typename prim, typename functor_t>
+void label_components(
+  Image<prim> const& img,
+  functor_t const& connected,
+  typename prim::index_t* labels)
+{
+  LabelComponents<prim, functor_t> lc(img, connected, labels);
+}
+
+/*
+ * Flat zones: connected components of equal values. Labels are the pixels
+ * with minimal index in their zones.
+ */
+template <typename prim>
+void label_flat_zones(Image<prim> const& img, typename prim::index_t* labels)
+{
+  using value_t = typename prim::value_t;
+
+  auto const& equal = [](value_t const& a, value_t const& b) ALWAYS_INL_L(bool)
+  {
+    return a == b;
+  };
+
+  label_components(img, equal, labels);
+}
+
+template <typename Primitives, typename Predicate>
+class LabelComponents
+{
+private:
+  using prim = Primitives;
+  using functor_t = Predicate;
+  using index_t = typename prim::index_t;
+  using value_t = typename prim::value_t;
+  using image_t = Image<prim>;
+  using edge_t = Edge<index_t>;
+  using vec_t = Coordinate<prim>;
+  using image_blocks_t = ImageBlocks<prim>;
+  using image_block_t = ImageBlock<prim>;
+  using block_t = Block<prim::n_dimensions>;
+  using block_index_t = typename block_t::block_index_t;
+  using block_vec_t = typename image_block_t::block_vec_t;
+  using dim_t = Dimensions<prim::n_dimensions>;
+
+  friend void label_components<prim, functor_t>(
+    image_t const& img,
+    functor_t const& connected,
+    index_t* labels);
+
+  static constexpr size_t n_dimensions = prim::n_dimensions;
+  static constexpr size_t n_neighbors = prim::n_neighbors;
+  // neighbors that precede a pixel in index order
+  static constexpr size_t n_directions = n_neighbors / 2U;
+
+  // image blocks support two or more dimensions
+  static_assert(n_dimensions >= 2U, "");
+  static_assert(
+    n_neighbors == 2U * n_dimensions ||
+    (n_neighbors == 8 && n_dimensions == 2), "");
+
+  struct thread_data
+  {
+    static constexpr size_t max_items_per_block = block_t::max_length;
+
+    block_index_t parents[max_items_per_block];
+    index_t local_to_global_index[max_items_per_block];
+    std::vector<edge_t> edges;
+  };
+
+  LabelComponents(image_t const& img, functor_t const& connected, index_t* labels);
+
+  void determine_directions();
+  void label_block(image_block_t const& block, thread_data* data);
+  void merge_blocks(thread_data* ts);
+
+  block_index_t find(block_index_t* parents, block_index_t x) const;
+
+  image_t const& img_;
+  functor_t const& connected_;
+  index_t* labels_;
+  int directions_[n_directions][n_dimensions];
+  index_t global_offsets_[n_directions];
+};
+
+template <typename prim, typename functor_t>
+LabelComponents<prim, functor_t>::LabelComponents(
+  image_t const& img,
+  functor_t const& connected,
+  index_t* labels) :
+  img_(img),
+  connected_(connected),
+  labels_(labels)
+{
+  if (img_.dimensions().length() == 0) return;
+
+  determine_directions();
+
+  image_blocks_t ib(img_);
+  thread_data* ts = new thread_data[thread_pool.max_threads()];
+
+  thread_pool.for_all_blocks<prim>(ib.dimensions(), [&](vec_t const& block_loc, thread_nr_t thread_nr) {
+    image_block_t block(ib, block_loc);
+
+    label_block(block, &ts[thread_nr]);
+  });
+
+  merge_blocks(ts);
+
+  delete[] ts;
+}
+
+/*
+ * Offsets to the neighbors with a smaller index: one step back along every
+ * dimension, plus the two upper diagonals for 8-connectivity.
+ */
+template <typename prim, typename functor_t>
+void LabelComponents<prim, functor_t>::determine_directions()
+{
+  for (size_t k = 0; k < n_directions; ++k)
+  {
+    for (dim_idx_t d = 0; d < n_dimensions; ++d)
+    {
+      directions_[k][d] = 0;
+    }
+  }
+
+  for (dim_idx_t d = 0; d < n_dimensions; ++d)
+  {
+    directions_[d][d] = -1;
+  }
+
+  if (n_dimensions == 2 && n_neighbors == 8)
+  {
+    directions_[2][0] = -1;
+    directions_[2][1] = -1;
+    directions_[3][0] = 1;
+    directions_[3][1] = -1;
+  }
+
+  dim_t const& dims = img_.dimensions();
+
+  for (size_t k = 0; k < n_directions; ++k)
+  {
+    index_t offset = 0;
+    index_t skip = 1;
+
+    for (dim_idx_t d = 0; d < n_dimensions; ++d)
+    {
+      offset += index_t(directions_[k][d]) * skip;
+      skip *= dims[d];
+    }
+
+    global_offsets_[k] = offset;
+  }
+}
+
+template <typename prim, typename functor_t>
+ALWAYS_INLINE_F typename LabelComponents<prim, functor_t>::block_index_t
+LabelComponents<prim, functor_t>::find(block_index_t* parents, block_index_t x) const
+{
+  while (parents[x] != x)
+  {
+    // path halving
+    parents[x] = parents[parents[x]];
+    x = parents[x];
+  }
+
+  return x;
+}
+
+/*
+ * Union-find over the local edges, linking to the root with the smaller
+ * (value, index). Local and global indices have the same order within a
+ * block, so local roots are the roots that connected_components would
+ * choose. Connected edges to preceding blocks are stored per thread.
+ */
+template <typename prim, typename functor_t>
+void LabelComponents<prim, functor_t>::label_block(
+  image_block_t const& block,
+  thread_data* data)
+{
+  value_t const* vals = img_.values();
+  dim_t const& dims = img_.dimensions();
+  dim_t const& block_dims = block.dimensions();
+  vec_t const& block_loc = block.location();
+  block_index_t* parents = data->parents;
+  index_t* local_to_global_index = data->local_to_global_index;
+  std::vector<edge_t>& edges = data->edges;
+
+  index_t origin[n_dimensions];
+  block_index_t local_offsets[n_directions];
+
+  for (dim_idx_t d = 0; d < n_dimensions; ++d)
+  {
+    origin[d] = block_loc[d] * block_t::max_dimensions[d];
+  }
+
+  for (size_t k = 0; k < n_directions; ++k)
+  {
+    block_index_t offset = 0;
+    block_index_t skip = 1;
+
+    for (dim_idx_t d = 0; d < n_dimensions; ++d)
+    {
+      offset += block_index_t(directions_[k][d]) * skip;
+      skip *= block_dims[d];
+    }
+
+    local_offsets[k] = offset;
+  }
+
+  auto const& precedes = [=](index_t a, index_t b) ALWAYS_INL_L(bool)
+  {
+    return vals[a] < vals[b] || (!(vals[b] < vals[a]) && a < b);
+  };
+
+  block_vec_t c;
+  c.init_zeros();
+
+  block.apply([&](index_t global_index, block_index_t local_index) ALWAYS_INLINE {
+    parents[local_index] = local_index;
+    local_to_global_index[local_index] = global_index;
+
+    for (size_t k = 0; k < n_directions; ++k)
+    {
+      bool in_image = true;
+      bool in_block = true;
+
+      for (dim_idx_t d = 0; d < n_dimensions; ++d)
+      {
+        index_t x = c[d] + directions_[k][d];
+
+        in_block = in_block && x < block_dims[d];
+        in_image = in_image && origin[d] + x < dims[d];
+      }
+
+      if (!in_image) continue;
+
+      index_t neighbor = global_index + global_offsets_[k];
+
+      if (!connected_(vals[global_index], vals[neighbor])) continue;
+
+      if (!in_block)
+      {
+        edges.push_back({global_index, neighbor});
+        continue;
+      }
+
+      block_index_t a = find(parents, local_index);
+      block_index_t b = find(parents, local_index + local_offsets[k]);
+
+      if (a == b) continue;
+
+      if (precedes(local_to_global_index[a], local_to_global_index[b]))
+      {
+        parents[b] = a;
+      }
+      else
+      {
+        parents[a] = b;
+      }
+    }
+
+    c.inc_index(block_dims);
+  });
+
+  block.apply([&](index_t global_index, block_index_t local_index) ALWAYS_INLINE {
+    labels_[global_index] = local_to_global_index[find(parents, local_index)];
+  });
+}
+
+/*
+ * Replaces the pixels of the cross-block edges by their local roots, which
+ * are their own labels, and drops self-loops and repeated edges. Local roots
+ * are not referred to by other roots yet, so labels can serve as the roots
+ * array of connected_components. Afterwards every local root refers directly
+ * to its component root.
+ */
+template <typename prim, typename functor_t>
+void LabelComponents<prim, functor_t>::merge_blocks(thread_data* ts)
+{
+  size_t n_threads = thread_pool.max_threads();
+  size_t* offsets = new size_t[n_threads + 1U];
+  index_t* labels = labels_;
+
+  // edges between the same local roots are mostly adjacent, so drop repeats
+  thread_pool.for_all_blocks(n_threads, [=](size_t t, thread_nr_t thread_nr) {
+    std::vector<edge_t>& thread_edges = ts[t].edges;
+    size_t m = 0;
+
+    for (edge_t const& e : thread_edges)
+    {
+      edge_t root_edge = {labels[e.a_], labels[e.b_]};
+
+      if (root_edge.a_ == root_edge.b_) continue;
+
+      if (m != 0 &&
+        thread_edges[m - 1U].a_ == root_edge.a_ &&
+        thread_edges[m - 1U].b_ == root_edge.b_) continue;
+
+      thread_edges[m++] = root_edge;
+    }
+
+    thread_edges.resize(m);
+    offsets[t] = m;
+  });
+
+  offsets[n_threads] = 0;
+  exclusive_sum(offsets, offsets + n_threads + 1U);
+
+  size_t n_edges = offsets[n_threads];
+
+  if (n_edges == 0)
+  {
+    delete[] offsets;
+    return;
+  }
+
+  edge_t* edges = new edge_t[n_edges];
+  edge_t* aux = new edge_t[n_edges];
+
+  thread_pool.for_all_blocks(n_threads, [=](size_t t, thread_nr_t thread_nr) {
+    std::copy(ts[t].edges.begin(), ts[t].edges.end(), edges + offsets[t]);
+    std::vector<edge_t>().swap(ts[t].edges);
+  });
+
+  delete[] offsets;
+
+  connected_components(edges, n_edges, aux, img_.values(), labels);
+
+  delete[] aux;
+  delete[] edges;
+
+  // local roots are left unchanged here, so there is no read-write conflict
+  thread_pool.for_all(img_.dimensions().length(), [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    index_t root = labels[labels[i]];
+
+    if (root != labels[i])
+    {
+      labels[i] = root;
+    }
+  });
+}
+
+NAMESPACE_PMT_END
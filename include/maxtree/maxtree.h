@@ -6,28 +6,112 @@
 #include "graph.h"
 #include "../image/image_blocks.h"
 #include "../sort/sort_item.h"
+#include "../sort/radix_sort_in_place.h"
+#include "../sort/multiway_merge.h"
 #include "rank_set.h"
 #include "union_by_rank.h"
 #include "estimate_quantiles.h"
 #include "graph_partitioning.h"
 #include "maxtree_trie.h"
+#include "attribute_accumulator.h"
+#include "topological_order.h"
+#include "maxtree_stats.h"
+#include "../misc/memory_tracker.h"
+#include "../parallel/compaction.h"
 
 NAMESPACE_PMT
 
-template <typename Primitives>
+/*
+ * How the exported edges are sorted by value. With edge_sort_merge, the
+ * edges of every subgraph and partition are sorted in cache, and these runs
+ * are merged per partition in a single pass over the edges. The in-place
+ * sort of a tight memory budget takes precedence.
+ */
+enum edge_sort_t
+{
+  edge_sort_radix,
+  edge_sort_merge
+};
+
+extern edge_sort_t edge_sort;
+
+template <
+  typename Primitives,
+  typename Accumulator = NoAttributes<typename Primitives::index_t>>
 class Maxtree;
 
 template <typename prim>
 void maxtree(Image<prim> const& image, typename prim::index_t* parents)
 {
-  Maxtree<prim> mp(image, parents);
+  NoAttributes<typename prim::index_t> accumulator;
+
+  Maxtree<prim> mp(image, parents, accumulator);
+}
+
+/*
+ * Also writes the time per phase and the sizes of the intermediate edge
+ * sets to stats, see MaxtreeStats. Without stats, the phases are not timed.
+ */
+template <typename prim>
+void maxtree(
+  Image<prim> const& image,
+  typename prim::index_t* parents,
+  MaxtreeStats* stats)
+{
+  NoAttributes<typename prim::index_t> accumulator;
+
+  Maxtree<prim> mp(image, parents, accumulator, stats);
 }
 
-template <typename Primitives>
+/*
+ * Computes the max-tree and the attributes of all nodes, as
+ * tree_scan(parents, n, attributes, w, plus) would afterwards. Attributes are
+ * accumulated within the image blocks while the block trees are built, so that
+ * only the nodes on the block boundary paths remain for tree_scan.
+ */
+template <
+  typename prim,
+  typename attribute_t,
+  typename functor1_t,
+  typename functor2_t>
+void maxtree(
+  Image<prim> const& image,
+  typename prim::index_t* parents,
+  attribute_t* attributes,
+  functor1_t const& w,
+  functor2_t const& plus,
+  MaxtreeStats* stats = nullptr)
+{
+  using accumulator_t = AttributeAccumulator<
+    typename prim::index_t,
+    attribute_t,
+    functor1_t,
+    functor2_t>;
+
+  accumulator_t accumulator(attributes, w, plus);
+
+  Maxtree<prim, accumulator_t> mp(image, parents, accumulator, stats);
+}
+
+/*
+ * Also writes a topological order of the nodes, see topological_order().
+ */
+template <typename prim>
+void maxtree(
+  Image<prim> const& image,
+  typename prim::index_t* parents,
+  typename prim::index_t* order)
+{
+  maxtree(image, parents);
+  topological_order(parents, image.dimensions().length(), order);
+}
+
+template <typename Primitives, typename Accumulator>
 class Maxtree
 {
 private:
   using prim = Primitives;
+  using accumulator_t = Accumulator;
   using index_t = typename Primitives::index_t;
   using image_t = Image<Primitives>;
   using image_blocks_t = ImageBlocks<Primitives>;
@@ -44,20 +128,46 @@ private:
     Image<prim> const& image,
     typename prim::index_t* parents);
 
+  friend void maxtree<prim>(
+    Image<prim> const& image,
+    typename prim::index_t* parents,
+    MaxtreeStats* stats);
+
+  template <typename P, typename A, typename F1, typename F2>
+  friend void maxtree(
+    Image<P> const& image,
+    typename P::index_t* parents,
+    A* attributes,
+    F1 const& w,
+    F2 const& plus,
+    MaxtreeStats* stats);
+
   constexpr static size_t n_dimensions = prim::n_dimensions;
   constexpr static size_t n_neighbors = prim::n_neighbors;
 
-  Maxtree(image_t const& image, index_t* parents);
+  Maxtree(
+    image_t const& image,
+    index_t* parents,
+    accumulator_t const& accumulator,
+    MaxtreeStats* stats = nullptr);
   ~Maxtree();
+  void compute();
+  void finish_stats(std::chrono::steady_clock::time_point const& start);
+  void choose_memory_strategy(graph_t const& graph);
   void determine_partition_offsets(graph_t* graph);    
   void create_partition_image(graph_t* graph);
   void export_edges(graph_t* graph);
   edge_t* sort_exported_edges(size_t n_edges);
+  edge_t* radix_sort_exported_edges(size_t n_edges);
+  edge_t* merge_exported_edges(size_t n_edges);
+  void sort_pairs_to_edges(size_t n_edges);
   void union_by_rank_partitions(edge_t* sorted_edges);
   size_t determine_max_edges();
+  void scan_boundary_attributes();
 
   image_t const& image_;
   index_t* parents_;
+  accumulator_t const& accumulator_;
 
   union 
   {
@@ -75,26 +185,116 @@ private:
     rank_set_t* rank_sets_aux2_;
   };
   
+  size_t aux1_size_ = 0;
+  size_t aux2_size_ = 0;
+  bool low_memory_ = false;
+  bool in_place_sort_ = false;
+  // passes over the exported edges of the sort that ran
+  size_t n_sort_passes_ = 0;
   size_t n_;
+  size_t n_subgraphs_ = 0;
   image_blocks_t ib_;
   size_t max_partitions_;
   quantile_t* quantiles_ = nullptr;
   uint8_t* partition_img_ = nullptr;
   size_t* partition_offsets_ = nullptr;
   size_t* partition_offsets_per_subgraph_ = nullptr;
+  uint8_t* boundary_ = nullptr;
+  MaxtreeStats* stats_;
 };
 
-template <typename prim>
-Maxtree<prim>::Maxtree(image_t const& image, index_t* parents) :
-  image_(image), parents_(parents), n_(image.dimensions().length()), ib_(image)
+template <typename prim, typename accumulator_t>
+Maxtree<prim, accumulator_t>::Maxtree(
+  image_t const& image,
+  index_t* parents,
+  accumulator_t const& accumulator,
+  MaxtreeStats* stats) :
+  image_(image),
+  parents_(parents),
+  accumulator_(accumulator),
+  n_(image.dimensions().length()),
+  ib_(image),
+  max_partitions_(1),
+  stats_(stats)
 {
+  if (stats_ == nullptr)
+  {
+    compute();
+    return;
+  }
+
+  *stats_ = MaxtreeStats();
+  stats_->n_nodes = n_;
+
+#ifdef PMT_STATS
+  thread_pool.reset_stats();
+#endif
+
+  memory_tracker.reset_peak();
+
+  auto start = std::chrono::steady_clock::now();
+
+  compute();
+  finish_stats(start);
+}
+
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::finish_stats(
+  std::chrono::steady_clock::time_point const& start)
+{
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+  stats_->total_seconds = diff.count();
+  stats_->peak_bytes = std::max(stats_->peak_bytes, memory_tracker.peak());
+  stats_->low_memory = low_memory_;
+  stats_->in_place_sort = in_place_sort_;
+
+  if (partition_offsets_ != nullptr)
+  {
+    stats_->partition_edge_counts.resize(max_partitions_);
+
+    for (size_t p = 0; p < max_partitions_; ++p)
+    {
+      stats_->partition_edge_counts[p] = partition_offsets_[p + 1U] - partition_offsets_[p];
+    }
+  }
+
+#ifdef PMT_STATS
+  size_t n_threads = thread_pool.max_threads();
+  double parallel_seconds = thread_pool.parallel_seconds();
+
+  stats_->thread_busy_seconds.resize(n_threads);
+  stats_->thread_idle_seconds.resize(n_threads);
+
+  for (size_t t = 0; t < n_threads; ++t)
+  {
+    double busy = thread_pool.busy_seconds(t);
+
+    stats_->thread_busy_seconds[t] = busy;
+    stats_->thread_idle_seconds[t] = std::max(parallel_seconds - busy, 0.0);
+  }
+#endif
+}
+
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::compute()
+{
+  index_t* parents = parents_;
+  image_t const& image = image_;
+
   if (n_ == 0) return;
   if (n_ == 1)
   {
     parents[0] = 0;
+    accumulator_.init(0);
     return;
   }
 
+  if (accumulator_t::enabled)
+  {
+    boundary_ = tracked_new<uint8_t>(n_);
+  }
+
   size_t n_edges = 0;
 
   {
@@ -103,31 +303,52 @@ Maxtree<prim>::Maxtree(image_t const& image, index_t* parents) :
       image.dimensions().length(),
       determine_max_edges());
 
-    reduce_edges(ib_, parents, &graph);
+    {
+      PhaseTimer timer(stats_, phase_reduce_edges);
+      reduce_edges(ib_, parents, &graph, accumulator_, boundary_);
+    }
 
     n_edges = graph.n_edges();
 
+    if (stats_ != nullptr)
+    {
+      stats_->n_reduced_edges = n_edges;
+    }
+
     if (n_edges == 0)
     {
       return;
     }
 
-    size_t alloc_sz = std::max(n_edges * sizeof(edge_sortpair_t), sizeof(rank_set_t) * n_);
+    aux1_size_ = std::max(n_edges * sizeof(edge_sortpair_t), sizeof(rank_set_t) * n_);
+    aux2_size_ = aux1_size_;
+    max_partitions_ = 1U << pmt::log2(hardware_concurrency);
+    choose_memory_strategy(graph);
 
-    aux1_ = malloc(alloc_sz);
-    aux2_ = malloc(alloc_sz);
-    
-    check(aux1_ != nullptr && aux2_ != nullptr);
+    // with low memory, aux1_ is allocated after the graph is freed
+    aux1_ = low_memory_ ? nullptr : tracked_malloc(aux1_size_);
+    aux2_ = tracked_malloc(aux2_size_);
+
+    check(aux2_ != nullptr && (low_memory_ || aux1_ != nullptr));
 
-    max_partitions_ = 1U << pmt::log2(hardware_concurrency);
     quantiles_ = new quantile_t[max_partitions_];
     partition_offsets_ = new size_t[max_partitions_ + 1U];
-    partition_offsets_per_subgraph_ = new size_t[graph.n_subgraphs() * max_partitions_];
+    n_subgraphs_ = graph.n_subgraphs();
+    partition_offsets_per_subgraph_ = new size_t[n_subgraphs_ * max_partitions_];
     
     if (max_partitions_ > 1)
     {
-      estimate_quantiles(graph, ib_.image().values(), max_partitions_, quantiles_, aux1_, aux2_);       
-      create_partition_image(&graph);
+      {
+        PhaseTimer timer(stats_, phase_estimate_quantiles);
+        estimate_quantiles(graph, ib_.image().values(), max_partitions_, quantiles_, aux1_, aux2_);       
+      }
+
+      {
+        PhaseTimer timer(stats_, phase_create_partition_image);
+        create_partition_image(&graph);
+      }
+
+      PhaseTimer timer(stats_, phase_partition_graph);
       partition_graph(
         ib_,
         &graph,
@@ -136,7 +357,8 @@ Maxtree<prim>::Maxtree(image_t const& image, index_t* parents) :
         max_partitions_,
         partition_offsets_per_subgraph_,
         edges_aux1_,
-        edges_aux2_);
+        edges_aux2_,
+        stats_ == nullptr ? nullptr : &stats_->n_partition_rounds);
     }
     else
     {
@@ -146,17 +368,46 @@ Maxtree<prim>::Maxtree(image_t const& image, index_t* parents) :
       }
     }
     
-    determine_partition_offsets(&graph);
+    {
+      PhaseTimer timer(stats_, phase_partition_offsets);
+      determine_partition_offsets(&graph);
+    }
 
     check(graph.n_edges() == partition_offsets_[max_partitions_]);
 
-    export_edges(&graph);
+    {
+      PhaseTimer timer(stats_, phase_export_edges);
+      export_edges(&graph);
+    }
 
     n_edges = graph.n_edges();
     // memory used by graph is freed
   }
 
-  edge_t* sorted_edges = sort_exported_edges(n_edges);
+  if (low_memory_ && !in_place_sort_)
+  {
+    aux1_ = tracked_malloc(aux1_size_);
+    check(aux1_ != nullptr);
+  }
+
+  edge_t* sorted_edges;
+
+  {
+    PhaseTimer timer(stats_, phase_sort_exported_edges);
+    sorted_edges = sort_exported_edges(n_edges);
+  }
+
+  if (in_place_sort_)
+  {
+    // the rank sets
+    aux1_ = tracked_malloc(aux1_size_);
+    check(aux1_ != nullptr);
+  }
+
+  if (stats_ != nullptr)
+  {
+    stats_->n_sort_digits = n_sort_passes_;
+  }
 
 #ifdef PMT_DEBUG
   parallel_for_all_blocks(max_partitions_, [=](size_t p, thread_nr_t t)
@@ -175,22 +426,81 @@ Maxtree<prim>::Maxtree(image_t const& image, index_t* parents) :
     });
 #endif        
 
-  union_by_rank_partitions(sorted_edges);
+  {
+    PhaseTimer timer(stats_, phase_union_by_rank);
+    union_by_rank_partitions(sorted_edges);
+  }
+
+  if (accumulator_t::enabled)
+  {
+    PhaseTimer timer(stats_, phase_scan_attributes);
+    scan_boundary_attributes();
+  }
 }
 
-template <typename prim>
-Maxtree<prim>::~Maxtree()
+template <typename prim, typename accumulator_t>
+Maxtree<prim, accumulator_t>::~Maxtree()
 {
   delete[] partition_offsets_per_subgraph_;
   delete[] partition_offsets_;
-  delete[] partition_img_;
+  tracked_delete(partition_img_, n_);
   delete[] quantiles_;
-  free(aux1_);
-  free(aux2_);
+  tracked_delete(boundary_, n_);
+  tracked_free(aux1_, aux1_size_);
+  tracked_free(aux2_, aux2_size_);
 }
 
-template <typename prim>
-void Maxtree<prim>::determine_partition_offsets(graph_t* graph)
+/*
+ * The default strategy has the graph, both aux buffers, the partition image
+ * and the roots of GraphPartitioning in memory at the same time. If that
+ * does not fit in the memory budget, a single partition is used: there is
+ * no partitioning, and aux1_ is only needed by the sort, after the graph is
+ * freed. The peak then is the larger of graph + aux2_ and aux1_ + aux2_.
+ *
+ * If that does not fit either, the exported edges are sorted in place in
+ * aux2_, which only holds the sort pairs, and aux1_ only holds the rank
+ * sets and is allocated after the sort. The peak is the larger of graph +
+ * sort pairs and sort pairs + rank sets.
+ */
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::choose_memory_strategy(graph_t const& graph)
+{
+  size_t partitioning_size = max_partitions_ > 1 ?
+    n_ * sizeof(partition_t) + graph.max_nodes() * sizeof(index_t) : 0;
+
+  if (memory_tracker.fits(aux1_size_ + aux2_size_ + partitioning_size))
+  {
+    return;
+  }
+
+  low_memory_ = true;
+  max_partitions_ = 1;
+
+  // the graph is in the current usage already
+  size_t graph_size = graph.max_edges() * sizeof(edge_t);
+
+  auto const& after_graph = [=](size_t size) {
+    return size > graph_size ? size - graph_size : 0;
+  };
+
+  if (memory_tracker.fits(std::max(aux1_size_, after_graph(aux1_size_ + aux2_size_))))
+  {
+    return;
+  }
+
+  in_place_sort_ = true;
+  aux1_size_ = n_ * sizeof(rank_set_t);
+  aux2_size_ = graph.n_edges() * sizeof(edge_sortpair_t);
+
+  if (!memory_tracker.fits(std::max(aux2_size_, after_graph(aux1_size_ + aux2_size_))))
+  {
+    warn("the max-tree needs more memory than the budget of " <<
+      memory_tracker.budget() << " bytes");
+  }
+}
+
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::determine_partition_offsets(graph_t* graph)
 {
   for (size_t k = 0; k < max_partitions_; ++k)
   {
@@ -223,11 +533,11 @@ void Maxtree<prim>::determine_partition_offsets(graph_t* graph)
 }
   
 
-template <typename prim>
-void Maxtree<prim>::create_partition_image(graph_t* graph)
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::create_partition_image(graph_t* graph)
 {
   {
-    partition_img_ = new partition_t[n_];    
+    partition_img_ = tracked_new<partition_t>(n_);
     value_t const* values = ib_.image().values();
 
     thread_pool.for_all(n_, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {     
@@ -236,8 +546,8 @@ void Maxtree<prim>::create_partition_image(graph_t* graph)
   }
 }
 
-template <typename prim>
-void Maxtree<prim>::export_edges(graph_t* graph)
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::export_edges(graph_t* graph)
 {
   value_t const* values = image_.values();
   size_t n_subgraphs = graph->n_subgraphs();
@@ -275,9 +585,47 @@ void Maxtree<prim>::export_edges(graph_t* graph)
   });
 }
 
-template <typename prim>
-typename Maxtree<prim>::edge_t *
-Maxtree<prim>::sort_exported_edges(size_t n_edges)
+template <typename prim, typename accumulator_t>
+typename Maxtree<prim, accumulator_t>::edge_t *
+Maxtree<prim, accumulator_t>::sort_exported_edges(size_t n_edges)
+{
+  edge_t* sorted_edges;
+
+  if (in_place_sort_)
+  {
+    // the digit levels and the conversion to edges
+    n_sort_passes_ = radix_sort_in_place(sort_edges_aux2_, n_edges) + 1U;
+    sort_pairs_to_edges(n_edges);
+    sorted_edges = edges_aux2_;
+  }
+  else if (edge_sort == edge_sort_merge)
+  {
+    // the digits of the runs and the merge
+    n_sort_passes_ = n_edges > 1 ? radix_sort_n_digits<uvalue_t>() + 1U : 0;
+    sorted_edges = merge_exported_edges(n_edges);
+  }
+  else
+  {
+    n_sort_passes_ = n_edges > 1 ? radix_sort_n_digits<uvalue_t>() : 0;
+    sorted_edges = radix_sort_exported_edges(n_edges);
+  }
+
+#ifdef PMT_DEBUG
+  value_t const* values = image_.values();
+
+  for (size_t i = 1; i < n_edges; ++i)
+  {
+    check(values[sorted_edges[i].a_] <= values[sorted_edges[i].b_]);
+    check(values[sorted_edges[i].a_] >= values[sorted_edges[i - 1].a_]);
+  }
+#endif        
+
+  return sorted_edges;
+}
+
+template <typename prim, typename accumulator_t>
+typename Maxtree<prim, accumulator_t>::edge_t *
+Maxtree<prim, accumulator_t>::radix_sort_exported_edges(size_t n_edges)
 {
   edge_t* sorted_edges =
     radix_sort_n_digits<uvalue_t>() & 1 ? edges_aux1_ : edges_aux2_;
@@ -304,21 +652,154 @@ Maxtree<prim>::sort_exported_edges(size_t n_edges)
     f_initial,
     f_out);
 
-#ifdef PMT_DEBUG
-  value_t const* values = image_.values();
+  return sorted_edges;
+}
 
-  for (size_t i = 1; i < n_edges; ++i)
+/*
+ * After export_edges, the edges of subgraph s in partition p are the run
+ * that ends at partition_offsets_per_subgraph_[s * max_partitions_ + p].
+ * The runs are sorted with radix_sort_seq, and every partition is split
+ * into chunks of about equal length at the same rank in all its runs, see
+ * multiway_split. The chunks are merged in parallel into the other aux
+ * buffer. Partitions are ordered by value, so this gives the same order
+ * as sorting all edges, except for edges with the same value.
+ */
+template <typename prim, typename accumulator_t>
+typename Maxtree<prim, accumulator_t>::edge_t *
+Maxtree<prim, accumulator_t>::merge_exported_edges(size_t n_edges)
+{
+  PMT_TRACE_SCOPE("MergeExportedEdges");
+
+  size_t n_subgraphs = n_subgraphs_;
+  size_t max_partitions = max_partitions_;
+  size_t const* partition_offsets = partition_offsets_;
+  size_t const* run_ends = partition_offsets_per_subgraph_;
+
+  auto const& run_begin = [=](size_t s, size_t p) {
+    return s == 0 ? partition_offsets[p] : run_ends[(s - 1U) * max_partitions + p];
+  };
+
+  edge_sortpair_t* aux1 = sort_edges_aux1_;
+  edge_sortpair_t* aux2 = sort_edges_aux2_;
+
+  thread_pool.for_all_blocks(n_subgraphs, [=](size_t s, thread_nr_t t) {
+    for (size_t p = 0; p < max_partitions; ++p)
+    {
+      size_t begin = run_begin(s, p);
+
+      radix_sort_seq(aux1 + begin, aux2 + begin, run_ends[s * max_partitions + p] - begin);
+    }
+  });
+
+  // radix_sort_seq leaves the runs in aux1_ after an odd number of digits
+  bool runs_in_aux1 = radix_sort_n_digits<uvalue_t>() & 1;
+  edge_sortpair_t const* runs = runs_in_aux1 ? aux1 : aux2;
+  edge_t* sorted_edges = runs_in_aux1 ? edges_aux2_ : edges_aux1_;
+
+  size_t chunk_length = std::max(
+    default_n_items_per_block,
+    div_roundup(n_edges, 4U * thread_pool.n_active_threads()));
+  size_t* first_chunks = new size_t[max_partitions + 1U];
+
+  for (size_t p = 0; p < max_partitions; ++p)
   {
-    check(values[sorted_edges[i].a_] <= values[sorted_edges[i].b_]);
-    check(values[sorted_edges[i].a_] >= values[sorted_edges[i - 1].a_]);
+    first_chunks[p] = div_roundup(partition_offsets[p + 1U] - partition_offsets[p], chunk_length);
+  }
+
+  exclusive_sum(first_chunks, first_chunks + max_partitions + 1U);
+
+  auto const& f_out = [](edge_t& out, edge_sortpair_t const& item) ALWAYS_INLINE {
+    out = item.data();
+  };
+
+  thread_pool.for_all_blocks(first_chunks[max_partitions], [=](size_t c, thread_nr_t t) {
+    size_t p = 0;
+
+    while (first_chunks[p + 1U] <= c)
+    {
+      ++p;
+    }
+
+    size_t n_chunks = first_chunks[p + 1U] - first_chunks[p];
+    size_t chunk = c - first_chunks[p];
+    size_t length = partition_offsets[p + 1U] - partition_offsets[p];
+    size_t rank_begin = length * chunk / n_chunks;
+    size_t rank_end = length * (chunk + 1U) / n_chunks;
+
+    edge_sortpair_t const** begins = new edge_sortpair_t const*[2U * n_subgraphs];
+    edge_sortpair_t const** ends = begins + n_subgraphs;
+    size_t* splits = new size_t[2U * n_subgraphs];
+
+    for (size_t s = 0; s < n_subgraphs; ++s)
+    {
+      begins[s] = runs + run_begin(s, p);
+      ends[s] = runs + run_ends[s * max_partitions + p];
+    }
+
+    multiway_split(begins, ends, n_subgraphs, rank_begin, splits);
+    multiway_split(begins, ends, n_subgraphs, rank_end, splits + n_subgraphs);
+
+    // only the runs with items in this chunk
+    size_t n_runs = 0;
+
+    for (size_t s = 0; s < n_subgraphs; ++s)
+    {
+      if (splits[s] == splits[n_subgraphs + s]) continue;
+
+      ends[n_runs] = begins[s] + splits[n_subgraphs + s];
+      begins[n_runs++] = begins[s] + splits[s];
+    }
+
+    multiway_merge(begins, ends, n_runs, sorted_edges + partition_offsets[p] + rank_begin, f_out);
+
+    delete[] splits;
+    delete[] begins;
+  });
+
+  delete[] first_chunks;
+
+  if (stats_ != nullptr)
+  {
+    stats_->n_sorted_runs = n_subgraphs * max_partitions;
   }
-#endif        
 
   return sorted_edges;
 }
 
-template <typename prim>
-void Maxtree<prim>::union_by_rank_partitions(edge_t* sorted_edges)
+/*
+ * Replaces the sort pairs in aux2_ by their edges, in place. An edge is
+ * smaller than a sort pair, so the edges of pairs [begin, end) can be
+ * written in parallel if they only overwrite pairs before begin, which is
+ * the case if end * sizeof(edge_t) <= begin * sizeof(edge_sortpair_t).
+ */
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::sort_pairs_to_edges(size_t n_edges)
+{
+  static_assert(sizeof(edge_t) < sizeof(edge_sortpair_t), "edges must be smaller than sort pairs");
+
+  edge_sortpair_t const* pairs = sort_edges_aux2_;
+  edge_t* edges = edges_aux2_;
+  size_t begin = std::min(n_edges, default_n_items_per_block);
+
+  for (size_t i = 0; i < begin; ++i)
+  {
+    edges[i] = pairs[i].data();
+  }
+
+  while (begin < n_edges)
+  {
+    size_t end = std::min(n_edges, begin * sizeof(edge_sortpair_t) / sizeof(edge_t));
+
+    thread_pool.for_all(end - begin, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+      edges[begin + i] = pairs[begin + i].data();
+    });
+
+    begin = end;
+  }
+}
+
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::union_by_rank_partitions(edge_t* sorted_edges)
 {
   rank_set_t* rank_sets =
     sorted_edges == edges_aux1_ ? rank_sets_aux2_ : rank_sets_aux1_;
@@ -339,8 +820,52 @@ void Maxtree<prim>::union_by_rank_partitions(edge_t* sorted_edges)
     });  
 }
 
-template <typename prim>
-size_t Maxtree<prim>::determine_max_edges()
+/*
+ * Nodes on the block boundary paths only have the attributes of the other
+ * nodes in their block so far. Their parents are boundary nodes as well, so
+ * they form a subtree which is compacted and scanned. aux1_ and aux2_ are not
+ * used anymore at this point and are reused.
+ */
+template <typename prim, typename accumulator_t>
+void Maxtree<prim, accumulator_t>::scan_boundary_attributes()
+{
+  index_t* RESTRICT index_map = reinterpret_cast<index_t*>(aux1_);
+  uint8_t const* boundary = boundary_;
+  index_t const* parents = parents_;
+  size_t n = n_;
+  auto const& on_boundary = [=](size_t i) ALWAYS_INL_L(bool) { return boundary[i]; };
+  Compaction compaction(n);
+  size_t m = compaction.count(on_boundary);
+  // with the in-place sort, aux2_ only has the size of the sort pairs
+  bool fits_aux2 = 2U * m * sizeof(index_t) <= aux2_size_;
+  index_t* RESTRICT nodes = fits_aux2 ?
+    reinterpret_cast<index_t*>(aux2_) : tracked_new<index_t>(2U * m);
+
+  compaction.scatter(on_boundary, [=](size_t i, size_t j) ALWAYS_INLINE {
+    index_map[i] = j;
+    nodes[j] = i;
+  });
+
+  index_t* RESTRICT compact_parents = nodes + m;
+
+  // a RankSet is at least the size of an index
+  check(n * sizeof(index_t) <= aux1_size_);
+
+  thread_pool.for_all(m, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    debug(boundary[parents[nodes[i]]]);
+    compact_parents[i] = index_map[parents[nodes[i]]];
+  });
+
+  accumulator_.scan(compact_parents, nodes, m);
+
+  if (!fits_aux2)
+  {
+    tracked_delete(nodes, 2U * m);
+  }
+}
+
+template <typename prim, typename accumulator_t>
+size_t Maxtree<prim, accumulator_t>::determine_max_edges()
 {
   dim_t const& dims = ib_.image().dimensions();
   dim_t const& grid_dims = ib_.dimensions();
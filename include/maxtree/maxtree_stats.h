@@ -0,0 +1,229 @@
+#pragma once
+
+#include "../common.h"
+#include "../parallel/thread_pool.h"
+#include "../parallel/perf_counters.h"
+#include "../misc/memory_tracker.h"
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+NAMESPACE_PMT
+
+/*
+ * Phases of the Maxtree pipeline, in order
+ */
+enum MaxtreePhase : unsigned
+{
+  phase_reduce_edges,
+  phase_estimate_quantiles,
+  phase_create_partition_image,
+  phase_partition_graph,
+  phase_partition_offsets,
+  phase_export_edges,
+  phase_sort_exported_edges,
+  phase_union_by_rank,
+  phase_scan_attributes,
+  n_maxtree_phases
+};
+
+inline char const* maxtree_phase_name(unsigned phase)
+{
+  static char const* names[n_maxtree_phases] = {
+    "reduce_edges",
+    "estimate_quantiles",
+    "create_partition_image",
+    "partition_graph",
+    "partition_offsets",
+    "export_edges",
+    "sort_exported_edges",
+    "union_by_rank",
+    "scan_attributes"};
+
+  return names[phase];
+}
+
+/*
+ * Instrumentation of a single max-tree computation. Phases that are skipped
+ * (e.g. partitioning with a single partition) keep a time of 0.
+ *
+ * n_reduced_edges: edges between block trees after reduce_edges.
+ * partition_edge_counts[p]: edges that partition p merges with union by rank.
+ * n_partition_rounds: rounds of GraphPartitioning, one per partition bit.
+ * n_sort_digits: passes of the sort over the exported edges: the radix
+ * digits, the digits of the runs plus the merge with edge_sort_merge, or
+ * the digit levels of the in-place sort plus the conversion to edges.
+ * n_sorted_runs: runs of exported edges that are merged with
+ * edge_sort_merge, 0 otherwise.
+ * peak_bytes, phase_peak_bytes: the peak of memory_tracker during the
+ * computation and during each phase. This includes tracked buffers outside
+ * the computation, e.g. of other threads.
+ * low_memory: the memory budget forced the single partition strategy.
+ * in_place_sort: the memory budget forced the in-place edge sort as well.
+ *
+ * thread_busy_seconds and thread_idle_seconds are only filled if PMT_STATS
+ * is defined, as they need timing inside the thread pool. They cover the
+ * parallel sections of the thread pool during the computation; a thread is
+ * idle if it has finished its work while others are still busy.
+ */
+struct MaxtreeStats
+{
+  double phase_seconds[n_maxtree_phases] = {};
+  double total_seconds = 0;
+
+  size_t n_nodes = 0;
+  size_t n_reduced_edges = 0;
+  size_t n_partition_rounds = 0;
+  size_t n_sort_digits = 0;
+  size_t n_sorted_runs = 0;
+  std::vector<size_t> partition_edge_counts;
+
+  size_t peak_bytes = 0;
+  size_t phase_peak_bytes[n_maxtree_phases] = {};
+  bool low_memory = false;
+  bool in_place_sort = false;
+
+  std::vector<double> thread_busy_seconds;
+  std::vector<double> thread_idle_seconds;
+
+  void write_json(std::ostream& os) const;
+  void write_csv(std::ostream& os) const;
+};
+
+/*
+ * Times a phase and measures its peak memory if stats is not null, and
+ * does nothing otherwise. With
+ * PMT_PERF_COUNTERS, the hardware counters of the phase are always recorded.
+ */
+class PhaseTimer
+{
+public:
+  PhaseTimer(MaxtreeStats* stats, unsigned phase) :
+    stats_(stats),
+    phase_(phase)
+#ifdef PMT_PERF_COUNTERS
+    , perf_(perf_counters, maxtree_phase_name(phase))
+#endif
+  {
+    if (stats_ != nullptr)
+    {
+      memory_tracker.reset_peak();
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~PhaseTimer()
+  {
+    if (stats_ != nullptr)
+    {
+      std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start_;
+
+      stats_->phase_seconds[phase_] += diff.count();
+
+      size_t peak = memory_tracker.peak();
+
+      stats_->phase_peak_bytes[phase_] = std::max(stats_->phase_peak_bytes[phase_], peak);
+      stats_->peak_bytes = std::max(stats_->peak_bytes, peak);
+    }
+  }
+
+private:
+  MaxtreeStats* stats_;
+  unsigned phase_;
+  std::chrono::steady_clock::time_point start_;
+#ifdef PMT_PERF_COUNTERS
+  PerfScope perf_;
+#endif
+};
+
+inline void MaxtreeStats::write_json(std::ostream& os) const
+{
+  os << "{\n";
+  os << "  \"n_nodes\": " << n_nodes << ",\n";
+  os << "  \"total_seconds\": " << total_seconds << ",\n";
+  os << "  \"phase_seconds\": {";
+
+  for (unsigned k = 0; k < n_maxtree_phases; ++k)
+  {
+    os << (k == 0 ? "" : ", ") << "\"" << maxtree_phase_name(k) << "\": " << phase_seconds[k];
+  }
+
+  os << "},\n";
+  os << "  \"peak_bytes\": " << peak_bytes << ",\n";
+  os << "  \"phase_peak_bytes\": {";
+
+  for (unsigned k = 0; k < n_maxtree_phases; ++k)
+  {
+    os << (k == 0 ? "" : ", ") << "\"" << maxtree_phase_name(k) << "\": " << phase_peak_bytes[k];
+  }
+
+  os << "},\n";
+  os << "  \"low_memory\": " << (low_memory ? "true" : "false") << ",\n";
+  os << "  \"in_place_sort\": " << (in_place_sort ? "true" : "false") << ",\n";
+  os << "  \"n_reduced_edges\": " << n_reduced_edges << ",\n";
+  os << "  \"n_partition_rounds\": " << n_partition_rounds << ",\n";
+  os << "  \"n_sort_digits\": " << n_sort_digits << ",\n";
+  os << "  \"n_sorted_runs\": " << n_sorted_runs << ",\n";
+
+  auto const& write_array = [&](char const* name, auto const& xs)
+  {
+    os << "  \"" << name << "\": [";
+
+    for (size_t k = 0; k < xs.size(); ++k)
+    {
+      os << (k == 0 ? "" : ", ") << xs[k];
+    }
+
+    os << "]";
+  };
+
+  write_array("partition_edge_counts", partition_edge_counts);
+  os << ",\n";
+  write_array("thread_busy_seconds", thread_busy_seconds);
+  os << ",\n";
+  write_array("thread_idle_seconds", thread_idle_seconds);
+  os << "\n}\n";
+}
+
+/*
+ * One row per value: name,index,value
+ */
+inline void MaxtreeStats::write_csv(std::ostream& os) const
+{
+  os << "name,index,value\n";
+  os << "n_nodes,0," << n_nodes << "\n";
+  os << "total_seconds,0," << total_seconds << "\n";
+
+  for (unsigned k = 0; k < n_maxtree_phases; ++k)
+  {
+    os << maxtree_phase_name(k) << "_seconds,0," << phase_seconds[k] << "\n";
+  }
+
+  os << "peak_bytes,0," << peak_bytes << "\n";
+
+  for (unsigned k = 0; k < n_maxtree_phases; ++k)
+  {
+    os << maxtree_phase_name(k) << "_peak_bytes,0," << phase_peak_bytes[k] << "\n";
+  }
+
+  os << "low_memory,0," << low_memory << "\n";
+  os << "in_place_sort,0," << in_place_sort << "\n";
+
+  os << "n_reduced_edges,0," << n_reduced_edges << "\n";
+  os << "n_partition_rounds,0," << n_partition_rounds << "\n";
+  os << "n_sort_digits,0," << n_sort_digits << "\n";
+  os << "n_sorted_runs,0," << n_sorted_runs << "\n";
+
+  for (size_t p = 0; p < partition_edge_counts.size(); ++p)
+  {
+    os << "partition_edge_count," << p << "," << partition_edge_counts[p] << "\n";
+  }
+
+  for (size_t t = 0; t < thread_busy_seconds.size(); ++t)
+  {
+    os << "thread_busy_seconds," << t << "," << thread_busy_seconds[t] << "\n";
+    os << "thread_idle_seconds," << t << "," << thread_idle_seconds[t] << "\n";
+  }
+}
+
+NAMESPACE_PMT_END
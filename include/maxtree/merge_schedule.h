@@ -0,0 +1,230 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/edge.h"
+#include "../parallel/thread_pool.h"
+#include <vector>
+
+NAMESPACE_PMT
+
+/*
+ * The merges done by tree_scan or rootfix for a fixed tree, recorded once so
+ * that other attributes can be computed without contracting the tree again.
+ * A merge {a_, b_} combines the attribute of b_ with the attribute of a_.
+ * Phases are replayed in order. The segments of a phase are independent and
+ * are replayed in parallel, the merges within a segment in order.
+ */
+template <typename Index>
+class MergeSchedule
+{
+public:
+  using index_t = Index;
+  using merge_t = Edge<index_t>;
+
+  enum direction {bottom_up, top_down};
+
+  size_t n() const
+  {
+    return n_;
+  }
+
+  size_t n_merges() const
+  {
+    return merges_.size();
+  }
+
+  size_t n_phases() const
+  {
+    return phases_.size() - 1U;
+  }
+
+  direction dir() const
+  {
+    return dir_;
+  }
+
+  template <typename functor_t>
+  void replay(functor_t const& f) const
+  {
+    merge_t const* merges = merges_.data();
+    size_t const* segments = segments_.data();
+
+    for (size_t p = 0; p + 1U < phases_.size(); ++p)
+    {
+      size_t const* phase_segments = segments + phases_[p];
+      size_t n_segments = phases_[p + 1U] - phases_[p];
+
+      thread_pool.for_all_blocks(n_segments, [=](size_t s, thread_nr_t t) {
+        replay_segment(merges + phase_segments[s], merges + phase_segments[s + 1U], f);
+      });
+    }
+  }
+
+  void reset(size_t n, direction dir)
+  {
+    n_ = n;
+    dir_ = dir;
+    merges_.clear();
+    segments_.assign(1U, 0U);
+    phases_.assign(1U, 0U);
+  }
+
+  void add_segment(merge_t const* begin, merge_t const* end)
+  {
+    if (begin == end) return;
+
+    merges_.insert(merges_.end(), begin, end);
+    segments_.push_back(merges_.size());
+  }
+
+  merge_t* add_segments(size_t n_merges, size_t segment_length)
+  {
+    size_t offset = merges_.size();
+    merges_.resize(offset + n_merges);
+
+    for (size_t i = segment_length; i < n_merges; i += segment_length)
+    {
+      segments_.push_back(offset + i);
+    }
+
+    if (n_merges > 0)
+    {
+      segments_.push_back(offset + n_merges);
+    }
+
+    return merges_.data() + offset;
+  }
+
+  void end_phase()
+  {
+    size_t n_segments = segments_.size() - 1U;
+
+    if (n_segments != phases_.back())
+    {
+      phases_.push_back(n_segments);
+    }
+  }
+
+private:
+  template <typename functor_t>
+  static NO_INLINE void replay_segment(
+    merge_t const* begin,
+    merge_t const* end,
+    functor_t const& f)
+  {
+    for (; begin != end; ++begin)
+    {
+      f(begin->a_, begin->b_);
+    }
+  }
+
+  size_t n_ = 0;
+  direction dir_ = bottom_up;
+  std::vector<merge_t> merges_;
+  std::vector<size_t> segments_{0U};
+  std::vector<size_t> phases_{0U};
+};
+
+/*
+ * Default recorder of TreeContract and rootfix, which records nothing.
+ */
+template <typename Index>
+struct NoMergeRecorder
+{
+  using index_t = Index;
+
+  static constexpr bool enabled = false;
+
+  INLINE void merge(index_t a, index_t b, thread_nr_t t) {}
+  INLINE void end_task(thread_nr_t t) {}
+  INLINE void end_phase() {}
+
+  template <typename functor_t>
+  INLINE void batch(size_t n, functor_t const& f) {}
+};
+
+/*
+ * Records merges into a MergeSchedule. Merges of the same thread within a
+ * phase are buffered. A task, i.e. the merges of a single work item, is never
+ * split over segments, because the merges of a task depend on each other.
+ */
+template <typename Index>
+class MergeRecorder
+{
+public:
+  using index_t = Index;
+  using schedule_t = MergeSchedule<index_t>;
+  using merge_t = typename schedule_t::merge_t;
+
+  static constexpr bool enabled = true;
+  static constexpr size_t min_segment_length = 4096U;
+
+  MergeRecorder(schedule_t* schedule) :
+    schedule_(*schedule),
+    buffers_(thread_pool.max_threads())
+  {
+  }
+
+  INLINE void merge(index_t a, index_t b, thread_nr_t t)
+  {
+    buffers_[t].merges_.push_back({a, b});
+  }
+
+  INLINE void end_task(thread_nr_t t)
+  {
+    ThreadBuffer& buffer = buffers_[t];
+
+    if (buffer.merges_.size() - buffer.segments_.back() >= min_segment_length)
+    {
+      buffer.segments_.push_back(buffer.merges_.size());
+    }
+  }
+
+  void end_phase()
+  {
+    for (ThreadBuffer& buffer : buffers_)
+    {
+      buffer.segments_.push_back(buffer.merges_.size());
+      merge_t const* merges = buffer.merges_.data();
+
+      for (size_t s = 0; s + 1U < buffer.segments_.size(); ++s)
+      {
+        schedule_.add_segment(
+          merges + buffer.segments_[s],
+          merges + buffer.segments_[s + 1U]);
+      }
+
+      buffer.merges_.clear();
+      buffer.segments_.assign(1U, 0U);
+    }
+
+    schedule_.end_phase();
+  }
+
+  // n independent merges f(i), 0 <= i < n, as a single phase
+  template <typename functor_t>
+  void batch(size_t n, functor_t const& f)
+  {
+    merge_t* out = schedule_.add_segments(n, default_n_items_per_block);
+
+    thread_pool.for_all(n, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+      out[i] = f(i);
+    });
+
+    schedule_.end_phase();
+  }
+
+private:
+  struct ThreadBuffer
+  {
+    std::vector<merge_t> merges_;
+    std::vector<size_t> segments_{0U};
+    // avoid false sharing
+    uint8_t padding_[cacheline_len];
+  };
+
+  schedule_t& schedule_;
+  std::vector<ThreadBuffer> buffers_;
+};
+
+NAMESPACE_PMT_END
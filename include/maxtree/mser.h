@@ -0,0 +1,310 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/bits.h"
+#include "../parallel/thread_pool.h"
+#include "../parallel/compaction.h"
+#include "../sort/sort_item.h"
+#include "../sort/radix_sort_parallel.h"
+#include "tree_scan.h"
+#include "nearest_ancestor.h"
+#include <atomic>
+
+NAMESPACE_PMT
+
+struct MserParams
+{
+  // levels between a region and the region it is compared with
+  double delta = 5.0;
+  size_t min_area = 60U;
+  size_t max_area = ~size_t(0);
+  // maximal relative growth of the area over delta levels
+  double max_variation = 0.25;
+};
+
+/*
+ * Maximally stable extremal regions of a max-tree. Region r is represented by
+ * a level root node(r), and is nested in region parent(r), or in none if
+ * parent(r) == none. The pixels of region r that are not in a nested region
+ * are pixels_begin(r) ... pixels_end(r). Regions are in the order of their
+ * nodes.
+ */
+template <typename Index>
+class Msers
+{
+public:
+  using index_t = Index;
+
+  static constexpr index_t none = ~index_t(0);
+
+  Msers() {}
+  Msers(Msers const&) = delete;
+  Msers& operator=(Msers const&) = delete;
+
+  ~Msers()
+  {
+    clear();
+  }
+
+  size_t n_regions() const
+  {
+    return n_regions_;
+  }
+
+  index_t node(size_t r) const
+  {
+    return nodes_[r];
+  }
+
+  index_t parent(size_t r) const
+  {
+    return parents_[r];
+  }
+
+  index_t const* pixels_begin(size_t r) const
+  {
+    return pixels_ + pixel_offsets_[r];
+  }
+
+  index_t const* pixels_end(size_t r) const
+  {
+    return pixels_ + pixel_offsets_[r + 1U];
+  }
+
+  template <typename I, typename value_t>
+  friend void msers(
+    I* parents,
+    size_t n,
+    value_t const* values,
+    MserParams const& params,
+    Msers<I>* out);
+
+private:
+  void clear()
+  {
+    delete[] nodes_;
+    delete[] parents_;
+    delete[] pixel_offsets_;
+    delete[] pixels_;
+    nodes_ = parents_ = pixels_ = nullptr;
+    pixel_offsets_ = nullptr;
+    n_regions_ = 0;
+  }
+
+  size_t n_regions_ = 0;
+  index_t* nodes_ = nullptr;
+  index_t* parents_ = nullptr;
+  size_t* pixel_offsets_ = nullptr;
+  index_t* pixels_ = nullptr;
+};
+
+/*
+ * Detects the MSERs of the bright regions. Use the max-tree of the inverted
+ * image for dark regions.
+ *
+ * The variation of a level root c is (area(a) - area(c)) / area(c), where a
+ * is the largest region containing c with a level of at least
+ * values[c] - delta. a is found by walking along the level roots, which are
+ * at least one level apart for integer values, so at most delta steps are
+ * needed. A region is stable if its variation is not larger than the
+ * variation of its parent region and smaller than the variations of its child
+ * regions. The root, the whole image, is never a region.
+ */
+template <typename index_t, typename value_t>
+void msers(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  MserParams const& params,
+  Msers<index_t>* out)
+{
+  using item_t = SortPair<index_t, index_t>;
+  constexpr index_t none = Msers<index_t>::none;
+
+  out->clear();
+
+  if (n == 0) return;
+
+  index_t* areas = new index_t[n];
+  index_t* level_roots = new index_t[n];
+  float* variations = new float[n];
+  std::atomic<uint8_t>* not_stable = new std::atomic<uint8_t>[n];
+
+  {
+    auto const& w = [](index_t i) ALWAYS_INL_L(index_t)
+    {
+      return 1U;
+    };
+
+    auto const& plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t)
+    {
+      return a + b;
+    };
+
+    tree_scan(parents, n, areas, w, plus);
+  }
+
+  key_roots(parents, n, [=](index_t i) ALWAYS_INL_L(value_t) { return values[i]; }, level_roots);
+
+  auto const& is_region = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return level_roots[i] == i && parents[i] != i;
+  };
+
+  double delta = params.delta;
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    not_stable[i].store(!is_region(i), std::memory_order_relaxed);
+
+    if (!is_region(i)) return;
+
+    index_t a = i;
+
+    while (parents[a] != a)
+    {
+      index_t next = level_roots[parents[a]];
+
+      if (double(values[i] - values[next]) > delta) break;
+
+      a = next;
+    }
+
+    variations[i] = float(areas[a] - areas[i]) / float(areas[i]);
+  });
+
+  // compare every region with its parent region
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    if (!is_region(i)) return;
+
+    index_t parent = level_roots[parents[i]];
+
+    if (!is_region(parent))
+    {
+      return;
+    }
+
+    if (variations[i] <= variations[parent])
+    {
+      not_stable[parent].store(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      not_stable[i].store(1, std::memory_order_relaxed);
+    }
+  });
+
+  size_t min_area = params.min_area;
+  size_t max_area = params.max_area;
+  float max_variation = params.max_variation;
+
+  auto const& is_mser = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return !not_stable[i].load(std::memory_order_relaxed) &&
+      areas[i] >= min_area &&
+      areas[i] <= max_area &&
+      variations[i] <= max_variation;
+  };
+
+  // region ids, in node order
+  index_t* region_ids = areas;
+  uint8_t* stable = new uint8_t[n];
+
+  // is_mser(i) only reads areas[i] before it is overwritten
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    stable[i] = is_mser(i);
+    region_ids[i] = none;
+  });
+
+  delete[] not_stable;
+  delete[] variations;
+
+  auto const& is_stable = [=](size_t i) ALWAYS_INL_L(bool) { return stable[i]; };
+  Compaction compaction(n);
+  size_t m = compaction.count(is_stable);
+
+  out->n_regions_ = m;
+  out->nodes_ = new index_t[m];
+  out->parents_ = new index_t[m];
+  out->pixel_offsets_ = new size_t[m + 1U];
+
+  index_t* nodes = out->nodes_;
+
+  compaction.scatter(is_stable, [=](size_t i, size_t r) ALWAYS_INLINE {
+    region_ids[i] = r;
+    nodes[r] = i;
+  });
+
+  // innermost region of every pixel
+  index_t* labels = level_roots;
+
+  nearest_marked_ancestor(parents, n, [=](index_t i) ALWAYS_INL_L(bool) { return stable[i]; }, labels);
+
+  index_t* region_parents = out->parents_;
+
+  thread_pool.for_all(m, [=](index_t r, thread_nr_t t) ALWAYS_INLINE {
+    index_t node = nodes[r];
+    region_parents[r] = parents[node] == node ? none : region_ids[labels[parents[node]]];
+  });
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    labels[i] = region_ids[labels[i]];
+  });
+
+  delete[] stable;
+  delete[] areas;
+
+  // pixel lists, sorted by region; pixels without a region are last
+  item_t* aux1 = new item_t[n];
+  item_t* aux2 = new item_t[n];
+  index_t* sorted = new index_t[n];
+  size_t* pixel_offsets = out->pixel_offsets_;
+
+  auto const& f_initial = [=](size_t i) ALWAYS_INL_L(item_t)
+  {
+    return {labels[i] == none ? index_t(m) : labels[i], index_t(i)};
+  };
+
+  auto const& f_out = [=](index_t& o, item_t const& item) ALWAYS_INLINE
+  {
+    o = item.data();
+  };
+
+  unsigned n_bits = pmt::log2(m | 1U) + 1U;
+
+  if (n == 1)
+  {
+    sorted[0] = 0;
+  }
+  else
+  {
+    radix_sort_parallel(sorted, aux1, aux2, n, 0U, n_bits, f_initial, f_out);
+  }
+
+  delete[] aux2;
+  delete[] aux1;
+
+  pixel_offsets[0] = 0;
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    index_t label = labels[sorted[i]];
+    index_t previous = i == 0 ? none : labels[sorted[i - 1U]];
+
+    if (label != previous && label != none)
+    {
+      pixel_offsets[label] = i;
+    }
+
+    bool last = i + 1U == n || labels[sorted[i + 1U]] != label;
+
+    if (last && label != none && label + 1U == m)
+    {
+      pixel_offsets[m] = i + 1U;
+    }
+  });
+
+  out->pixels_ = sorted;
+
+  delete[] labels;
+}
+
+NAMESPACE_PMT_END
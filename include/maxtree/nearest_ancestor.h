@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../common.h"
+#include "rootfix.h"
+
+NAMESPACE_PMT
+
+/*
+ * For every node, the nearest ancestor (or the node itself) for which
+ * marked(i) holds. The root is always treated as marked.
+ */
+template <typename index_t, typename functor_t>
+void nearest_marked_ancestor(
+  index_t* parents,
+  size_t n,
+  functor_t const& marked,
+  index_t* out)
+{
+  constexpr index_t none = ~index_t(0);
+
+  auto const& w = [=](index_t i) ALWAYS_INL_L(index_t)
+  {
+    return parents[i] == i || marked(i) ? i : none;
+  };
+
+  // the descendant wins if it is marked
+  auto const& plus = [](index_t ancestor, index_t descendant) ALWAYS_INL_L(index_t)
+  {
+    return descendant != none ? descendant : ancestor;
+  };
+
+  rootfix(parents, n, out, w, plus);
+}
+
+/*
+ * For every node, the highest ancestor (or the node itself) that is reached
+ * without changing key(i). For a max-tree with key(i) = values[i] these are
+ * the level roots, the canonical nodes.
+ */
+template <typename index_t, typename functor_t>
+void key_roots(
+  index_t* parents,
+  size_t n,
+  functor_t const& key,
+  index_t* out)
+{
+  auto const& marked = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return key(i) != key(parents[i]);
+  };
+
+  nearest_marked_ancestor(parents, n, marked, out);
+}
+
+NAMESPACE_PMT_END
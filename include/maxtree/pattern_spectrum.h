@@ -0,0 +1,213 @@
+#pragma once
+
+#include "../common.h"
+#include "../parallel/thread_pool.h"
+#include "../parallel/item_blocks.h"
+#include "nearest_ancestor.h"
+#include <algorithm>
+
+NAMESPACE_PMT
+
+/*
+ * Number of thresholds that are at most attribute, i.e. the number of
+ * openings with threshold t (keep nodes with attribute >= t) that keep
+ * the node. thresholds must be ascending.
+ */
+template <typename attribute_t>
+ALWAYS_INLINE_F size_t threshold_bin(
+  attribute_t const& attribute,
+  attribute_t const* thresholds,
+  size_t n_thresholds)
+{
+  return std::upper_bound(thresholds, thresholds + n_thresholds, attribute) - thresholds;
+}
+
+/*
+ * Pattern spectrum of the attribute openings with the given ascending
+ * thresholds. spectrum[k] is the volume removed by the opening with threshold
+ * thresholds[k], but not by the opening with threshold thresholds[k - 1]. The
+ * last bin spectrum[n_thresholds] is the volume above the root level that is
+ * kept by all openings.
+ *
+ * The volume of node i is (values[i] - values[parents[i]]) * areas[i], so
+ * nodes that are not level roots contribute nothing. attributes and areas
+ * are the outputs of tree_scan, and can be the same array.
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename attribute_t,
+  typename area_t,
+  typename spectrum_t>
+void pattern_spectrum(
+  index_t const* parents,
+  size_t n,
+  value_t const* values,
+  attribute_t const* attributes,
+  area_t const* areas,
+  attribute_t const* thresholds,
+  size_t n_thresholds,
+  spectrum_t* spectrum)
+{
+  size_t n_bins = n_thresholds + 1U;
+  // avoid false sharing
+  size_t stride = div_roundup(n_bins * sizeof(spectrum_t), cacheline_len) * cacheline_len / sizeof(spectrum_t);
+  size_t n_threads = thread_pool.max_threads();
+  spectrum_t* histograms = new spectrum_t[n_threads * stride];
+
+  std::fill(histograms, histograms + n_threads * stride, spectrum_t(0));
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    index_t parent = parents[i];
+
+    if (parent == i || values[i] == values[parent])
+    {
+      return;
+    }
+
+    size_t bin = threshold_bin(attributes[i], thresholds, n_thresholds);
+
+    histograms[t * stride + bin] +=
+      spectrum_t(values[i] - values[parent]) * spectrum_t(areas[i]);
+  });
+
+  for (size_t k = 0; k < n_bins; ++k)
+  {
+    spectrum_t sum = 0;
+
+    for (size_t t = 0; t < n_threads; ++t)
+    {
+      sum += histograms[t * stride + k];
+    }
+
+    spectrum[k] = sum;
+  }
+
+  delete[] histograms;
+}
+
+/*
+ * Calls f(i, k, previous, value) for every pixel i and every threshold k, with
+ * the value of pixel i after the attribute opening (direct rule) with
+ * threshold thresholds[k], and the value after the previous opening (or the
+ * original value for k = 0). Parallel over blocks of pixels.
+ *
+ * Every node jumps to the parent of the highest ancestor with the same bin,
+ * so each pixel needs at most one jump per threshold if the attribute is
+ * increasing.
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename attribute_t,
+  typename functor_t>
+void apply_attribute_openings(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  attribute_t const* attributes,
+  attribute_t const* thresholds,
+  size_t n_thresholds,
+  functor_t const& f)
+{
+  uint8_t* bins = new uint8_t[n];
+  index_t* jumps = new index_t[n];
+
+  check(n_thresholds < 255U);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    bins[i] = threshold_bin(attributes[i], thresholds, n_thresholds);
+  });
+
+  key_roots(parents, n, [=](index_t i) ALWAYS_INL_L(uint8_t) { return bins[i]; }, jumps);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    jumps[i] = parents[jumps[i]];
+  });
+
+  ItemBlocks blocks(n);
+
+  blocks.apply([=](size_t i) ALWAYS_INLINE {
+    index_t x = i;
+    value_t previous = values[i];
+
+    for (size_t k = 0; k < n_thresholds; ++k)
+    {
+      // the root is always kept
+      while (bins[x] <= k && parents[x] != x)
+      {
+        x = jumps[x];
+      }
+
+      f(i, k, previous, values[x]);
+      previous = values[x];
+    }
+  });
+
+  delete[] jumps;
+  delete[] bins;
+}
+
+/*
+ * All attribute openings with the given ascending thresholds.
+ * Interleaved output: profile[i * n_thresholds + k] is the value of pixel i
+ * after the opening with threshold thresholds[k].
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename attribute_t>
+void attribute_profile(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  attribute_t const* attributes,
+  attribute_t const* thresholds,
+  size_t n_thresholds,
+  value_t* profile)
+{
+  auto const& f = [=](size_t i, size_t k, value_t previous, value_t value) ALWAYS_INLINE
+  {
+    profile[i * n_thresholds + k] = value;
+  };
+
+  apply_attribute_openings(parents, n, values, attributes, thresholds, n_thresholds, f);
+}
+
+/*
+ * Differential attribute profile: the differences between successive
+ * attribute openings with the given ascending thresholds, where the first
+ * channel is the difference between the image and the first opening.
+ * Channel k of pixel i is written to dap[i * stride + k], so the profiles of
+ * several attributes can be interleaved in one stack by offsetting dap.
+ *
+ * For closings, pass the max-tree of the inverted image with the inverted
+ * values: the differences of the openings of the inverted image are the
+ * differences of the closings.
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename attribute_t,
+  typename out_t>
+void differential_attribute_profile(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  attribute_t const* attributes,
+  attribute_t const* thresholds,
+  size_t n_thresholds,
+  out_t* dap,
+  size_t stride)
+{
+  check(stride >= n_thresholds);
+
+  auto const& f = [=](size_t i, size_t k, value_t previous, value_t value) ALWAYS_INLINE
+  {
+    dap[i * stride + k] = out_t(previous) - out_t(value);
+  };
+
+  apply_attribute_openings(parents, n, values, attributes, thresholds, n_thresholds, f);
+}
+
+NAMESPACE_PMT_END
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../common.h"
+#include "../parallel/thread_pool.h"
+#include "../parallel/compaction.h"
+#include "nearest_ancestor.h"
+#include <algorithm>
+
+NAMESPACE_PMT
+
+/*
+ * Removes the nodes for which criterion(i) is false, except the root, and
+ * merges them into their nearest kept ancestor, like the direct filtering
+ * rule. The kept nodes are numbered in index order, and the pruned tree is
+ * written to new_parents[0 ... m). Returns m.
+ *
+ * old_to_new[i] is the new node that node i was merged into (itself if kept),
+ * so it also maps pixels to nodes of the pruned tree. new_to_old[j] is the
+ * original index of new node j. new_parents and new_to_old need room for n
+ * nodes.
+ */
+template <typename index_t, typename functor_t>
+size_t prune_tree(
+  index_t* parents,
+  size_t n,
+  functor_t const& criterion,
+  index_t* new_parents,
+  index_t* old_to_new,
+  index_t* new_to_old)
+{
+  if (n == 0) return 0;
+
+  uint8_t* kept = new uint8_t[n];
+  index_t* survivors = new index_t[n];
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    kept[i] = parents[i] == i || criterion(i);
+  });
+
+  nearest_marked_ancestor(parents, n, [=](index_t i) ALWAYS_INL_L(bool) { return kept[i]; }, survivors);
+
+  // new indices by a prefix sum over blocks
+  auto const& is_kept = [=](size_t i) ALWAYS_INL_L(bool) { return kept[i]; };
+  Compaction compaction(n);
+  size_t m = compaction.count(is_kept);
+
+  compaction.scatter(is_kept, [=](size_t i, size_t j) ALWAYS_INLINE {
+    old_to_new[i] = j;
+    new_to_old[j] = i;
+  });
+
+  delete[] kept;
+
+  thread_pool.for_all(m, [=](index_t j, thread_nr_t t) ALWAYS_INLINE {
+    index_t old = new_to_old[j];
+    index_t parent = parents[old];
+
+    new_parents[j] = parent == old ? j : old_to_new[survivors[parent]];
+  });
+
+  // kept nodes are their own survivors
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    if (survivors[i] != i)
+    {
+      old_to_new[i] = old_to_new[survivors[i]];
+    }
+  });
+
+  delete[] survivors;
+
+  return m;
+}
+
+/*
+ * Copies the attributes of the kept nodes to the pruned tree.
+ */
+template <typename index_t, typename attribute_t>
+void remap_attributes(
+  index_t const* new_to_old,
+  size_t m,
+  attribute_t const* attributes,
+  attribute_t* new_attributes)
+{
+  thread_pool.for_all(m, [=](index_t j, thread_nr_t t) ALWAYS_INLINE {
+    new_attributes[j] = attributes[new_to_old[j]];
+  });
+}
+
+NAMESPACE_PMT_END
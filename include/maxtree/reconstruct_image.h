@@ -7,6 +7,8 @@
 #include "../misc/random.h"
 #include "../misc/integerhash.h"
 #include "../misc/edge.h"
+#include "tree_scan.h"
+#include "rootfix.h"
 //#include "rootfix2.h"
 //#include "rootfix_seq.h"
 #include <vector>
@@ -111,4 +113,241 @@ void reconstruct_image(value_t const*values, size_t n, value_t* values_out, inde
   delete[] roots;
 }
 
+/*
+ * Max rule: a node is kept if the criterion holds for the node or for one of
+ * its descendants. Removed nodes take the value of the first kept ancestor.
+ */
+template <typename index_t, typename value_t, typename functor_t>
+void reconstruct_image_max(value_t const*values, size_t n, value_t* values_out, index_t* parents, functor_t const &criterion)
+{
+  uint8_t* kept = new uint8_t[n];
+
+  auto const& w = [=](index_t i) ALWAYS_INL_L(uint8_t)
+  {
+    return parents[i] == i || criterion(i);
+  };
+
+  auto const& plus = [](uint8_t a, uint8_t b) ALWAYS_INL_L(uint8_t)
+  {
+    return a | b;
+  };
+
+  tree_scan(parents, n, kept, w, plus);
+
+  reconstruct_image(values, n, values_out, parents, [=](index_t i) ALWAYS_INL_L(bool) {
+    return kept[i];
+  });
+
+  delete[] kept;
+}
+
+/*
+ * Min rule: a node is kept if the criterion holds for the node and for all
+ * of its ancestors.
+ */
+template <typename index_t, typename value_t, typename functor_t>
+void reconstruct_image_min(value_t const*values, size_t n, value_t* values_out, index_t* parents, functor_t const &criterion)
+{
+  uint8_t* kept = new uint8_t[n];
+
+  auto const& w = [=](index_t i) ALWAYS_INL_L(uint8_t)
+  {
+    return parents[i] == i || criterion(i);
+  };
+
+  auto const& plus = [](uint8_t a, uint8_t b) ALWAYS_INL_L(uint8_t)
+  {
+    return a & b;
+  };
+
+  rootfix(parents, n, kept, w, plus);
+
+  reconstruct_image(values, n, values_out, parents, [=](index_t i) ALWAYS_INL_L(bool) {
+    return kept[i];
+  });
+
+  delete[] kept;
+}
+
+/*
+ * Subtractive rule: as the direct rule, but kept nodes are lowered by the
+ * level differences of all removed ancestors, so the structure above a removed
+ * node is preserved.
+ */
+template <typename index_t, typename value_t, typename functor_t>
+void reconstruct_image_subtractive(value_t const*values, size_t n, value_t* values_out, index_t* parents, functor_t const &criterion)
+{
+  value_t* lowered = new value_t[n];
+
+  auto const& w = [=](index_t i) ALWAYS_INL_L(value_t)
+  {
+    index_t parent = parents[i];
+
+    if (parent == i || criterion(i))
+    {
+      return value_t(0);
+    }
+
+    return values[i] - values[parent];
+  };
+
+  auto const& plus = [](value_t a, value_t b) ALWAYS_INL_L(value_t)
+  {
+    return a + b;
+  };
+
+  // sum of the level differences of removed nodes on the path to the root
+  rootfix(parents, n, lowered, w, plus);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    lowered[i] = values[i] - lowered[i];
+  });
+
+  reconstruct_image(lowered, n, values_out, parents, [=](index_t i) ALWAYS_INL_L(bool) {
+    return parents[i] == i || criterion(i);
+  });
+
+  delete[] lowered;
+}
+
+/*
+ * Lanes of the Viterbi rule, for the cost best(i) of the subtree of node i
+ * with i kept. The cost of a child c is min(best(c), remove(c)), with
+ * remove(c) the cost of removing the whole subtree. The attribute of node i
+ * is the map y -> min(y + a_[i], b_[i]) from the costs y of its pending
+ * descendants to best(i), and p_[i], q_[i] map the cost of i to the cost
+ * seen by its current parent. Maps x -> min(x + a, b) are closed under
+ * composition, so partially merged chains are contracted as well.
+ */
+template <typename index_t, typename cost_t, typename functor_t>
+struct ViterbiLanes
+{
+  static constexpr bool has_pending = true;
+
+  static constexpr cost_t inf = std::numeric_limits<cost_t>::has_infinity ?
+    std::numeric_limits<cost_t>::infinity() :
+    std::numeric_limits<cost_t>::max();
+
+  ALWAYS_INLINE_F void init(index_t i) const
+  {
+    a_[i] = cost_keep_(i);
+    b_[i] = inf;
+    p_[i] = cost_t(0);
+    q_[i] = inf;
+  }
+
+  // the cost of b seen by its parent, as y -> min(y + *a, *b)
+  ALWAYS_INLINE_F void transfer(index_t b, cost_t* a_out, cost_t* b_out) const
+  {
+    *a_out = a_[b] + p_[b];
+    *b_out = std::min(std::min(b_[b], remove_[b]) + p_[b], q_[b]);
+  }
+
+  ALWAYS_INLINE_F void merge(index_t a, index_t b) const
+  {
+    cost_t ta, tb;
+
+    transfer(b, &ta, &tb);
+    a_[a] += std::min(ta, tb);
+  }
+
+  ALWAYS_INLINE_F void attach(index_t b, index_t c) const
+  {
+    if (q_[c] != inf)
+    {
+      b_[b] = std::min(b_[b], q_[c] + a_[b]);
+    }
+
+    a_[b] += p_[c];
+  }
+
+  ALWAYS_INLINE_F void merge_partial(index_t a, index_t b) const
+  {
+    cost_t ta, tb;
+
+    transfer(b, &ta, &tb);
+    b_[a] = std::min(b_[a], tb + a_[a]);
+    a_[a] += ta;
+  }
+
+  ALWAYS_INLINE_F void relink(index_t a, index_t b, index_t c) const
+  {
+    transfer(b, p_ + c, q_ + c);
+  }
+
+  ALWAYS_INLINE_F void merge_pending(index_t a, index_t c) const
+  {
+    a_[a] += std::min(std::min(a_[c], b_[c]), remove_[c]);
+  }
+
+  functor_t const& cost_keep_;
+  cost_t const* RESTRICT remove_;
+  cost_t* RESTRICT a_;
+  cost_t* RESTRICT b_;
+  cost_t* RESTRICT p_;
+  cost_t* RESTRICT q_;
+};
+
+/*
+ * Viterbi rule: removes whole subtrees, such that the sum of
+ * cost_keep(i) over kept nodes and cost_remove(i) over removed nodes is
+ * minimal. The root is always kept.
+ *
+ * The removal costs of the subtrees are a tree_scan, and the costs with the
+ * nodes kept a second contraction with ViterbiLanes.
+ */
+template <
+  typename index_t,
+  typename value_t,
+  typename functor1_t,
+  typename functor2_t>
+void reconstruct_image_viterbi(
+  value_t const*values,
+  size_t n,
+  value_t* values_out,
+  index_t* parents,
+  functor1_t const &cost_keep,
+  functor2_t const &cost_remove)
+{
+  using cost_t = decltype(cost_keep(index_t(0)) + cost_remove(index_t(0)));
+  using lanes_t = ViterbiLanes<index_t, cost_t, functor1_t>;
+
+  if (n == 0) return;
+
+  cost_t* remove = new cost_t[n];
+  // a_, b_, p_ and q_ of the lanes
+  cost_t* maps = new cost_t[4U * n];
+  uint8_t* keep = new uint8_t[n];
+  uint8_t* kept = new uint8_t[n];
+
+  tree_scan(parents, n, remove, cost_remove, [](cost_t a, cost_t b) ALWAYS_INL_L(cost_t) {
+    return a + b;
+  });
+
+  tree_contract(parents, n, lanes_t{cost_keep, remove, maps, maps + n, maps + 2U * n, maps + 3U * n});
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    keep[i] = parents[i] == i || !(remove[i] < std::min(maps[i], maps[n + i]));
+  });
+
+  delete[] maps;
+  delete[] remove;
+
+  auto const& plus = [](uint8_t a, uint8_t b) ALWAYS_INL_L(uint8_t)
+  {
+    return a & b;
+  };
+
+  // a node is kept if it and all its ancestors are kept
+  rootfix(parents, n, kept, [=](index_t i) ALWAYS_INL_L(uint8_t) { return keep[i]; }, plus);
+
+  delete[] keep;
+
+  reconstruct_image(values, n, values_out, parents, [=](index_t i) ALWAYS_INL_L(bool) {
+    return kept[i];
+  });
+
+  delete[] kept;
+}
+
 NAMESPACE_PMT_END
\ No newline at end of file
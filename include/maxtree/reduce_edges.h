@@ -10,10 +10,13 @@
 #include "../misc/exclusive_sum.h"
 #include "../misc/trie_queue.h"
 #include "../maxtree/maxtree_trie.h"
+#include "attribute_accumulator.h"
 
 NAMESPACE_PMT
 
-template <typename Primitives>
+template <
+  typename Primitives,
+  typename Accumulator = NoAttributes<typename Primitives::index_t>>
 class ReduceEdges;
 
 template <typename prim>
@@ -22,14 +25,34 @@ void reduce_edges(
   typename prim::index_t* parents,
   Graph<typename prim::index_t>* graph)
 {
-  ReduceEdges<prim> re(ib, parents, graph);
+  NoAttributes<typename prim::index_t> accumulator;
+
+  ReduceEdges<prim> re(ib, parents, graph, accumulator, nullptr);
+}
+
+/*
+ * Also accumulates attributes in every block. Afterwards the attributes of
+ * nodes that are not on a path from the block boundary to the block root
+ * are final. For the other nodes boundary[i] is set to 1, and their
+ * attributes only include the attributes of non-boundary children.
+ */
+template <typename prim, typename accumulator_t>
+void reduce_edges(
+  ImageBlocks<prim> const& ib,
+  typename prim::index_t* parents,
+  Graph<typename prim::index_t>* graph,
+  accumulator_t const& accumulator,
+  uint8_t* boundary)
+{
+  ReduceEdges<prim, accumulator_t> re(ib, parents, graph, accumulator, boundary);
 }
 
-template <typename Primitives>
+template <typename Primitives, typename Accumulator>
 class ReduceEdges
 {
 private:
   using prim = Primitives;
+  using accumulator_t = Accumulator;
   using index_t = typename prim::index_t;
   using value_t = typename prim::value_t;
   using uvalue_t = decltype(pmt::unsigned_conversion(value_t(0)));
@@ -53,6 +76,13 @@ private:
     typename prim::index_t* parents,
     Graph<typename prim::index_t>* graph);
 
+  friend void reduce_edges<prim, accumulator_t>(
+    ImageBlocks<prim> const& ib,
+    typename prim::index_t* parents,
+    Graph<typename prim::index_t>* graph,
+    accumulator_t const& accumulator,
+    uint8_t* boundary);
+
   constexpr static size_t n_dimensions = prim::n_dimensions;
   constexpr static size_t n_neighbors = prim::n_neighbors;
 
@@ -82,8 +112,14 @@ private:
     queue_t queue;
   };
 
-  ReduceEdges(image_blocks_t const& ib, index_t* parents, graph_t* graph);
+  ReduceEdges(
+    image_blocks_t const& ib,
+    index_t* parents,
+    graph_t* graph,
+    accumulator_t const& accumulator,
+    uint8_t* boundary);
   void determine_local_edges(image_block_t const& block, vec_t const& block_loc, index_t block_nr, thread_data* data);
+  void accumulate_local_attributes(size_t n_items_in_block, thread_data* data);
   void iterate_blocks_parallel();
   void determine_edge_offsets();
   void determine_edge_offsets_2d_8n();
@@ -103,13 +139,22 @@ private:
   image_blocks_t const& ib_;
   index_t* parents_;
   graph_t& graph_;
+  accumulator_t const& accumulator_;
+  uint8_t* boundary_;
 };
 
-template <typename prim>
-ReduceEdges<prim>::ReduceEdges(image_blocks_t const& ib, index_t* parents, graph_t* graph) :
+template <typename prim, typename accumulator_t>
+ReduceEdges<prim, accumulator_t>::ReduceEdges(
+  image_blocks_t const& ib,
+  index_t* parents,
+  graph_t* graph,
+  accumulator_t const& accumulator,
+  uint8_t* boundary) :
   ib_(ib),
   parents_(parents),
-  graph_(*graph)
+  graph_(*graph),
+  accumulator_(accumulator),
+  boundary_(boundary)
 {
   if (n_dimensions == 2 && n_neighbors == 8)
   {
@@ -125,8 +170,8 @@ ReduceEdges<prim>::ReduceEdges(image_blocks_t const& ib, index_t* parents, graph
   graph_.determine_n_edges();
 }
 
-template <typename prim>
-void ReduceEdges<prim>::determine_local_edges(image_block_t const& block, vec_t const& block_loc, index_t block_nr, thread_data* data)
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::determine_local_edges(image_block_t const& block, vec_t const& block_loc, index_t block_nr, thread_data* data)
 {
   size_t n_items_in_block = block.dimensions().length();
   value_t const* vals = ib_.image().values();
@@ -196,6 +241,11 @@ void ReduceEdges<prim>::determine_local_edges(image_block_t const& block, vec_t
     local_to_global_index[local_index] = global_index;    
   });
 
+  if (accumulator_t::enabled)
+  {
+    accumulate_local_attributes(n_items_in_block, data);
+  }
+
   edge_t* out = graph_.subgraph(block_nr);
         
   for (size_t i = 0; i != n_items_in_block; ++i)
@@ -216,10 +266,44 @@ void ReduceEdges<prim>::determine_local_edges(image_block_t const& block, vec_t
   graph_.set_local_edge_count(block_nr, out - graph_.subgraph(block_nr));
 }
 
-template <typename prim>
-void ReduceEdges<prim>::iterate_blocks_parallel()
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::accumulate_local_attributes(
+  size_t n_items_in_block,
+  thread_data* data)
+{
+  block_index_t const* rank_to_index = data->rank_to_index;
+  block_index_t const* parents = data->parents;
+  index_t const* local_to_global_index = data->local_to_global_index;
+
+  for (size_t i = 0; i != n_items_in_block; ++i)
+  {
+    index_t global_index = local_to_global_index[i];
+
+    accumulator_.init(global_index);
+    boundary_[global_index] = data->visited.is_set(i);
+  }
+
+  // a parent has a lower rank than its children
+  for (size_t i = n_items_in_block; i-- > 1;)
+  {
+    block_index_t k = rank_to_index[i];
+
+    if (data->visited.is_set(k))
+    {
+      // the parent of k may be outside of the block
+      continue;
+    }
+
+    accumulator_.merge(local_to_global_index[parents[k]], local_to_global_index[k]);
+  }
+}
+
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::iterate_blocks_parallel()
 {
-  thread_data* ts = new thread_data[thread_pool.max_threads()];
+  PMT_TRACE_SCOPE("ReduceEdges");
+
+  thread_data* ts = tracked_new<thread_data>(thread_pool.max_threads());
 
   thread_pool.for_all_blocks<prim>(ib_.dimensions(), [=](vec_t const& block_loc, thread_nr_t thread_nr) {
     //printf("thread %ld doing block %d %d\n", thread_nr, block_loc[1], block_loc[0]);
@@ -243,11 +327,11 @@ void ReduceEdges<prim>::iterate_blocks_parallel()
 
 //    out(graph_.n_edges());
 
-  delete[] ts;
+  tracked_delete(ts, thread_pool.max_threads());
 }
 
-template <typename prim>
-void ReduceEdges<prim>::determine_edge_offsets()
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::determine_edge_offsets()
 {
   vec_t block_loc;
   block_loc.init_zeros();
@@ -280,8 +364,8 @@ void ReduceEdges<prim>::determine_edge_offsets()
   check(offset == graph_.max_edges());
 }
 
-template <typename prim>
-void ReduceEdges<prim>::determine_edge_offsets_2d_8n()
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::determine_edge_offsets_2d_8n()
 {
   vec_t block_loc;
   block_loc.init_zeros();
@@ -353,9 +437,9 @@ void ReduceEdges<prim>::determine_edge_offsets_2d_8n()
   check(offset == graph_.max_edges());
 }
 
-template <typename prim>
+template <typename prim, typename accumulator_t>
 ALWAYS_INLINE_F void
-ReduceEdges<prim>::add_edge(edge_t* out, index_t current, index_t neighbor)
+ReduceEdges<prim, accumulator_t>::add_edge(edge_t* out, index_t current, index_t neighbor)
 {
   value_t const* values = ib_.image().values();
 
@@ -365,8 +449,8 @@ ReduceEdges<prim>::add_edge(edge_t* out, index_t current, index_t neighbor)
     *out = {neighbor, current};    
 }
 
-template <typename prim>
-size_t ReduceEdges<prim>::add_global_edges(
+template <typename prim, typename accumulator_t>
+size_t ReduceEdges<prim, accumulator_t>::add_global_edges(
   dim_t const& block_dims,
   dim_idx_t d,
   dim_idx_t d_exclude,
@@ -431,8 +515,8 @@ size_t ReduceEdges<prim>::add_global_edges(
   return ctr;
 }
 
-template <typename prim>
-void ReduceEdges<prim>::add_global_edges(image_block_t const& block, vec_t const& block_loc, index_t block_nr)
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::add_global_edges(image_block_t const& block, vec_t const& block_loc, index_t block_nr)
 {
   size_t ctr = 0;
   dim_t const& dims = ib_.image().dimensions();
@@ -462,8 +546,8 @@ void ReduceEdges<prim>::add_global_edges(image_block_t const& block, vec_t const
   graph_.set_global_edge_count(block_nr, ctr);
 }
 
-template <typename prim>
-void ReduceEdges<prim>::add_global_edges_2d_8n(image_block_t const& block, vec_t const& block_loc, index_t block_nr)
+template <typename prim, typename accumulator_t>
+void ReduceEdges<prim, accumulator_t>::add_global_edges_2d_8n(image_block_t const& block, vec_t const& block_loc, index_t block_nr)
 {
   debug(n_dimensions == 2 && n_neighbors == 8);
 
@@ -7,12 +7,22 @@
 #include "../misc/random.h"
 #include "../misc/integerhash.h"
 #include "../misc/edge.h"
+#include "merge_schedule.h"
 #include <vector>
 
 NAMESPACE_PMT
 
-template <typename index_t, typename attribute_t, typename functor1_t, typename functor2_t>
-void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t const& w, functor2_t const& plus)
+/*
+ * init(i) initializes node i, and merge(x, root) merges the attribute of
+ * ancestor root to x.
+ */
+template <typename index_t, typename functor1_t, typename functor2_t, typename recorder_t>
+void rootfix_contract(
+  index_t* parents,
+  size_t n,
+  functor1_t const& init,
+  functor2_t const& merge,
+  recorder_t* recorder)
 {
 //  using edge_t = Edge<index_t>;
 
@@ -27,7 +37,7 @@ void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t con
     {
       roots[i] = parents[i];
       node_indices[i] = i;
-      attributes[i] = w(i);
+      init(i);
     });
 
   typename rng<index_t>::type r;
@@ -65,7 +75,7 @@ void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t con
     update_later.push_back(n_compacted);
     total_compacted += n_compacted;
 
-    select.item_blocks().apply([=](index_t i)
+    select.item_blocks().apply_with_thread_nr([=](index_t i, thread_nr_t t)
     {
       index_t x = node_indices[i];
       index_t root = roots[x];
@@ -77,9 +87,12 @@ void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t con
 
       index_t root_root = roots[root];
       
-      attributes[x] = plus(attributes[root], attributes[x]);
+      merge(x, root);
+      recorder->merge(x, root, t);
       roots[x] = root_root;
     });
+
+    recorder->end_phase();
   }
 
   index_t* nodes_to_update = aux + total_compacted;
@@ -92,7 +105,12 @@ void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t con
     thread_pool.for_all(len, [=](index_t i, thread_nr_t t) {
       index_t x = nodes_to_update[i];
       index_t root = roots[x];
-      attributes[x] = plus(attributes[root], attributes[x]);
+      merge(x, root);
+    });
+
+    recorder->batch(len, [=](size_t i) ALWAYS_INL_L(Edge<index_t>) {
+      index_t x = nodes_to_update[i];
+      return {x, roots[x]};
     });
   }
 
@@ -101,4 +119,63 @@ void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t con
   delete[] roots;
 }
 
+template <typename index_t, typename attribute_t, typename functor1_t, typename functor2_t>
+void rootfix(index_t* parents, size_t n, attribute_t *attributes, functor1_t const& w, functor2_t const& plus)
+{
+  attribute_t* RESTRICT attr = attributes;
+  NoMergeRecorder<index_t> recorder;
+
+  auto const& init = [=](index_t i) ALWAYS_INLINE
+  {
+    attr[i] = w(i);
+  };
+
+  auto const& merge = [=](index_t x, index_t root) ALWAYS_INLINE
+  {
+    attr[x] = plus(attr[root], attr[x]);
+  };
+
+  rootfix_contract(parents, n, init, merge, &recorder);
+}
+
+/*
+ * Records the merges of rootfix, for repeated scans of the same tree with
+ * rootfix(schedule, attributes, w, plus).
+ */
+template <typename index_t>
+void schedule_rootfix(
+  index_t* parents,
+  size_t n,
+  MergeSchedule<index_t>* schedule)
+{
+  schedule->reset(n, MergeSchedule<index_t>::top_down);
+
+  MergeRecorder<index_t> recorder(schedule);
+
+  auto const& init = [](index_t i) ALWAYS_INLINE {};
+  auto const& merge = [](index_t x, index_t root) ALWAYS_INLINE {};
+
+  rootfix_contract(parents, n, init, merge, &recorder);
+}
+
+template <typename index_t, typename attribute_t, typename functor1_t, typename functor2_t>
+void rootfix(
+  MergeSchedule<index_t> const& schedule,
+  attribute_t* attributes,
+  functor1_t const& w,
+  functor2_t const& plus)
+{
+  check(schedule.dir() == MergeSchedule<index_t>::top_down);
+
+  attribute_t* RESTRICT attr = attributes;
+
+  thread_pool.for_all(schedule.n(), [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    attr[i] = w(i);
+  });
+
+  schedule.replay([=](index_t x, index_t root) ALWAYS_INLINE {
+    attr[x] = plus(attr[root], attr[x]);
+  });
+}
+
 NAMESPACE_PMT_END
\ No newline at end of file
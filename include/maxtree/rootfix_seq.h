@@ -50,4 +50,28 @@ void rootfix_seq(index_t* parents, size_t n, attribute_t *RESTRICT attributes, f
   delete[] roots;
 }
 
+/*
+ * As above, with a topological order of the nodes, see topological_order().
+ */
+template <typename index_t, typename attribute_t, typename functor1_t, typename functor2_t>
+void rootfix_seq(
+  index_t const* order,
+  index_t const* parents,
+  size_t n,
+  attribute_t* RESTRICT attributes,
+  functor1_t const& w,
+  functor2_t const& plus)
+{
+  if (n == 0) return;
+
+  attributes[order[0]] = w(order[0]);
+
+  for (size_t i = 1; i < n; ++i)
+  {
+    index_t node = order[i];
+
+    attributes[node] = plus(attributes[parents[node]], w(node));
+  }
+}
+
 NAMESPACE_PMT_END
\ No newline at end of file
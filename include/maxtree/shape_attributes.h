@@ -0,0 +1,396 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/coordinate.h"
+#include "../image/image.h"
+#include "../parallel/thread_pool.h"
+#include "tree_scan.h"
+#include <algorithm>
+#include <cmath>
+
+NAMESPACE_PMT
+
+/*
+ * Moment, bounding box and perimeter attributes of all nodes of a max-tree,
+ * stored as separate arrays. Only the attributes of level roots describe
+ * complete components.
+ *
+ * The perimeter is the number of faces between a component and its
+ * complement or the image border, along the axes (the contour length in 2-D
+ * and the surface area in 3-D).
+ */
+template <typename Index, size_t NDimensions>
+class ShapeAttributes
+{
+public:
+  using index_t = Index;
+  using moment_t = double;
+  using perimeter_t = int64_t;
+
+  static constexpr size_t n_dimensions = NDimensions;
+  static constexpr size_t n_products = n_dimensions * (n_dimensions + 1U) / 2U;
+
+  ShapeAttributes() {}
+  ShapeAttributes(ShapeAttributes const&) = delete;
+  ShapeAttributes& operator=(ShapeAttributes const&) = delete;
+
+  ~ShapeAttributes()
+  {
+    clear();
+  }
+
+  size_t n() const { return n_; }
+
+  index_t area(index_t i) const { return areas_[i]; }
+  index_t bbox_min(index_t i, size_t d) const { return mins_[d][i]; }
+  index_t bbox_max(index_t i, size_t d) const { return maxs_[d][i]; }
+  index_t extent(index_t i, size_t d) const { return maxs_[d][i] - mins_[d][i] + 1U; }
+  perimeter_t perimeter(index_t i) const { return perimeters_[i]; }
+
+  moment_t centroid(index_t i, size_t d) const
+  {
+    return sums_[d][i] / moment_t(areas_[i]);
+  }
+
+  /*
+   * Central second moment, divided by the area
+   */
+  moment_t central_moment(index_t i, size_t d1, size_t d2) const
+  {
+    return products_[product_nr(d1, d2)][i] / moment_t(areas_[i]) -
+      centroid(i, d1) * centroid(i, d2);
+  }
+
+  /*
+   * Trace of the normalized central moments, Hu's first invariant in 2-D
+   */
+  moment_t inertia(index_t i) const;
+
+  /*
+   * Square root of the ratio between the largest and the smallest principal
+   * moment; infinite for lines
+   */
+  moment_t elongation(index_t i) const;
+
+  /*
+   * Isoperimetric ratio, 1 for squares and cubes and smaller for less compact
+   * shapes
+   */
+  moment_t compactness(index_t i) const;
+
+  /*
+   * Raw sums, e.g. for attribute filters
+   */
+  index_t const* areas() const { return areas_; }
+  moment_t const* sums(size_t d) const { return sums_[d]; }
+  moment_t const* products(size_t d1, size_t d2) const { return products_[product_nr(d1, d2)]; }
+  index_t const* mins(size_t d) const { return mins_[d]; }
+  index_t const* maxs(size_t d) const { return maxs_[d]; }
+  perimeter_t const* perimeters() const { return perimeters_; }
+
+  template <typename prim>
+  friend void shape_attributes(
+    Image<prim> const& image,
+    typename prim::index_t* parents,
+    ShapeAttributes<typename prim::index_t, prim::n_dimensions>* out);
+
+private:
+  struct Lanes;
+
+  static constexpr size_t product_nr(size_t d1, size_t d2)
+  {
+    return d1 > d2 ? product_nr(d2, d1) : d2 * (d2 + 1U) / 2U + d1;
+  }
+
+  void allocate(size_t n);
+  void clear();
+
+  size_t n_ = 0;
+  index_t* areas_ = nullptr;
+  moment_t* sums_[n_dimensions] = {};
+  moment_t* products_[n_products] = {};
+  index_t* mins_[n_dimensions] = {};
+  index_t* maxs_[n_dimensions] = {};
+  perimeter_t* perimeters_ = nullptr;
+};
+
+/*
+ * The pixel values are written before the contraction, so init does nothing.
+ * Every array is merged separately, with a fixed number of lanes.
+ */
+template <typename index_t, size_t n_dimensions>
+struct ShapeAttributes<index_t, n_dimensions>::Lanes
+{
+  using shape_t = ShapeAttributes<index_t, n_dimensions>;
+
+  INLINE void init(index_t i) const {}
+
+  ALWAYS_INLINE_F void merge(index_t a, index_t b) const
+  {
+    shape_t& s = *shape_;
+
+    s.areas_[a] += s.areas_[b];
+    s.perimeters_[a] += s.perimeters_[b];
+
+    for (size_t d = 0; d < n_dimensions; ++d)
+    {
+      s.sums_[d][a] += s.sums_[d][b];
+      s.mins_[d][a] = std::min(s.mins_[d][a], s.mins_[d][b]);
+      s.maxs_[d][a] = std::max(s.maxs_[d][a], s.maxs_[d][b]);
+    }
+
+    for (size_t k = 0; k < n_products; ++k)
+    {
+      s.products_[k][a] += s.products_[k][b];
+    }
+  }
+
+  shape_t* shape_;
+};
+
+template <typename index_t, size_t n_dimensions>
+void ShapeAttributes<index_t, n_dimensions>::allocate(size_t n)
+{
+  clear();
+
+  n_ = n;
+  areas_ = new index_t[n];
+  perimeters_ = new perimeter_t[n];
+
+  for (size_t d = 0; d < n_dimensions; ++d)
+  {
+    sums_[d] = new moment_t[n];
+    mins_[d] = new index_t[n];
+    maxs_[d] = new index_t[n];
+  }
+
+  for (size_t k = 0; k < n_products; ++k)
+  {
+    products_[k] = new moment_t[n];
+  }
+}
+
+template <typename index_t, size_t n_dimensions>
+void ShapeAttributes<index_t, n_dimensions>::clear()
+{
+  delete[] areas_;
+  delete[] perimeters_;
+  areas_ = nullptr;
+  perimeters_ = nullptr;
+
+  for (size_t d = 0; d < n_dimensions; ++d)
+  {
+    delete[] sums_[d];
+    delete[] mins_[d];
+    delete[] maxs_[d];
+    sums_[d] = nullptr;
+    mins_[d] = maxs_[d] = nullptr;
+  }
+
+  for (size_t k = 0; k < n_products; ++k)
+  {
+    delete[] products_[k];
+    products_[k] = nullptr;
+  }
+
+  n_ = 0;
+}
+
+template <typename index_t, size_t n_dimensions>
+typename ShapeAttributes<index_t, n_dimensions>::moment_t
+ShapeAttributes<index_t, n_dimensions>::inertia(index_t i) const
+{
+  moment_t trace = 0;
+
+  for (size_t d = 0; d < n_dimensions; ++d)
+  {
+    trace += central_moment(i, d, d);
+  }
+
+  return trace / std::pow(moment_t(areas_[i]), moment_t(2) / n_dimensions);
+}
+
+template <typename index_t, size_t n_dimensions>
+typename ShapeAttributes<index_t, n_dimensions>::moment_t
+ShapeAttributes<index_t, n_dimensions>::elongation(index_t i) const
+{
+  static_assert(n_dimensions <= 3U, "elongation is defined for 1-D to 3-D");
+
+  moment_t largest = 0;
+  moment_t smallest = 0;
+
+  if (n_dimensions == 1U)
+  {
+    return 1;
+  }
+
+  if (n_dimensions == 2U)
+  {
+    moment_t a = central_moment(i, 0, 0);
+    moment_t b = central_moment(i, 0, 1);
+    moment_t c = central_moment(i, 1, 1);
+    moment_t mean = (a + c) / 2;
+    moment_t r = std::sqrt((a - c) * (a - c) / 4 + b * b);
+
+    largest = mean + r;
+    smallest = mean - r;
+  }
+  else
+  {
+    // eigenvalues of a symmetric 3 x 3 matrix, trigonometric solution
+    moment_t m[3][3];
+
+    for (size_t d1 = 0; d1 < 3U; ++d1)
+    {
+      for (size_t d2 = 0; d2 < 3U; ++d2)
+      {
+        m[d1][d2] = central_moment(i, d1, d2);
+      }
+    }
+
+    moment_t off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+    moment_t q = (m[0][0] + m[1][1] + m[2][2]) / 3;
+    moment_t p = std::sqrt(((m[0][0] - q) * (m[0][0] - q) +
+      (m[1][1] - q) * (m[1][1] - q) +
+      (m[2][2] - q) * (m[2][2] - q) + 2 * off) / 6);
+
+    if (p == 0)
+    {
+      return 1;
+    }
+
+    moment_t b[3][3];
+
+    for (size_t d1 = 0; d1 < 3U; ++d1)
+    {
+      for (size_t d2 = 0; d2 < 3U; ++d2)
+      {
+        b[d1][d2] = (m[d1][d2] - (d1 == d2 ? q : 0)) / p;
+      }
+    }
+
+    moment_t det =
+      b[0][0] * (b[1][1] * b[2][2] - b[1][2] * b[2][1]) -
+      b[0][1] * (b[1][0] * b[2][2] - b[1][2] * b[2][0]) +
+      b[0][2] * (b[1][0] * b[2][1] - b[1][1] * b[2][0]);
+    moment_t phi = std::acos(std::min(moment_t(1), std::max(moment_t(-1), det / 2))) / 3;
+    moment_t pi = std::acos(moment_t(-1));
+
+    largest = q + 2 * p * std::cos(phi);
+    smallest = q + 2 * p * std::cos(phi + 2 * pi / 3);
+  }
+
+  return smallest <= 0 ? INFINITY : std::sqrt(largest / smallest);
+}
+
+template <typename index_t, size_t n_dimensions>
+typename ShapeAttributes<index_t, n_dimensions>::moment_t
+ShapeAttributes<index_t, n_dimensions>::compactness(index_t i) const
+{
+  // (2 D)^D A^(D - 1) / P^D
+  moment_t ratio = moment_t(2 * n_dimensions) *
+    std::pow(moment_t(areas_[i]), moment_t(n_dimensions - 1U) / n_dimensions) /
+    moment_t(perimeters_[i]);
+
+  return std::pow(ratio, moment_t(n_dimensions));
+}
+
+/*
+ * Computes the shape attributes of all nodes with a single tree contraction.
+ * The coordinates are updated incrementally along the image lines, so only
+ * the first pixel of every line needs divisions.
+ *
+ * The perimeter of a pixel is the number of its faces on the image border,
+ * plus the number of neighbors with a lower value, minus the number of
+ * neighbors with a higher value. Summed over a component, the faces between
+ * pixels in the component cancel.
+ */
+template <typename prim>
+void shape_attributes(
+  Image<prim> const& image,
+  typename prim::index_t* parents,
+  ShapeAttributes<typename prim::index_t, prim::n_dimensions>* out)
+{
+  using index_t = typename prim::index_t;
+  using value_t = typename prim::value_t;
+  using coordinate_t = Coordinate<prim>;
+  using shape_t = ShapeAttributes<index_t, prim::n_dimensions>;
+  using moment_t = typename shape_t::moment_t;
+  using perimeter_t = typename shape_t::perimeter_t;
+
+  constexpr size_t n_dimensions = prim::n_dimensions;
+
+  auto const& dims = image.dimensions();
+  size_t n = dims.length();
+
+  out->allocate(n);
+
+  if (n == 0) return;
+
+  value_t const* values = image.values();
+  size_t line_length = dims[0];
+  size_t n_lines = n / line_length;
+  size_t strides[n_dimensions];
+
+  strides[0] = 1U;
+
+  for (size_t d = 1; d < n_dimensions; ++d)
+  {
+    strides[d] = strides[d - 1U] * dims[d - 1U];
+  }
+
+  shape_t* s = out;
+  // about default_n_items_per_block pixels per block
+  size_t n_lines_per_block = std::max<size_t>(1U, default_n_items_per_block / line_length);
+
+  thread_pool.for_all(n_lines, [=](size_t line, thread_nr_t t) {
+    size_t begin = line * line_length;
+    coordinate_t c = coordinate_t::from_index(begin, dims);
+
+    for (size_t i = begin; i != begin + line_length; ++i, ++c[0])
+    {
+      value_t value = values[i];
+      perimeter_t perimeter = 0;
+
+      s->areas_[i] = 1U;
+
+      for (size_t d = 0; d < n_dimensions; ++d)
+      {
+        s->sums_[d][i] = c[d];
+        s->mins_[d][i] = c[d];
+        s->maxs_[d][i] = c[d];
+
+        for (size_t d2 = 0; d2 <= d; ++d2)
+        {
+          s->products_[shape_t::product_nr(d2, d)][i] = moment_t(c[d]) * moment_t(c[d2]);
+        }
+
+        if (c[d] == 0)
+        {
+          ++perimeter;
+        }
+        else
+        {
+          value_t neighbor = values[i - strides[d]];
+          perimeter += (neighbor < value) - (value < neighbor);
+        }
+
+        if (c[d] + 1U == dims[d])
+        {
+          ++perimeter;
+        }
+        else
+        {
+          value_t neighbor = values[i + strides[d]];
+          perimeter += (neighbor < value) - (value < neighbor);
+        }
+      }
+
+      s->perimeters_[i] = perimeter;
+    }
+  }, n_lines_per_block);
+
+  tree_contract(parents, n, typename shape_t::Lanes{s});
+}
+
+NAMESPACE_PMT_END
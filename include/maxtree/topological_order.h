@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/bits.h"
+#include "../parallel/thread_pool.h"
+#include "../sort/sort_item.h"
+#include "../sort/radix_sort_parallel.h"
+#include "tree_scan.h"
+#include "rootfix.h"
+#include <algorithm>
+
+NAMESPACE_PMT
+
+/*
+ * Number of edges from every node to the root.
+ */
+template <typename index_t>
+void node_depths(index_t* parents, size_t n, index_t* depths)
+{
+  auto const& w = [=](index_t i) ALWAYS_INL_L(index_t)
+  {
+    return parents[i] != i;
+  };
+
+  auto const& plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t)
+  {
+    return a + b;
+  };
+
+  rootfix(parents, n, depths, w, plus);
+}
+
+/*
+ * Largest of the n depths, with a maximum per chunk and a write per chunk.
+ */
+template <typename index_t>
+index_t max_depth(index_t const* depths, size_t n)
+{
+  size_t n_threads = thread_pool.max_threads();
+  index_t* max_depths = new index_t[n_threads];
+
+  std::fill(max_depths, max_depths + n_threads, index_t(0));
+
+  size_t n_chunks = div_roundup(n, default_n_items_per_block);
+
+  thread_pool.for_all_blocks(n_chunks, [=](size_t c, thread_nr_t t) {
+    size_t begin = c * default_n_items_per_block;
+    size_t end = std::min(begin + default_n_items_per_block, n);
+    index_t max_depth = max_depths[t];
+
+    for (; begin != end; ++begin)
+    {
+      max_depth = std::max(max_depth, depths[begin]);
+    }
+
+    max_depths[t] = max_depth;
+  });
+
+  index_t result = *std::max_element(max_depths, max_depths + n_threads);
+
+  delete[] max_depths;
+
+  return result;
+}
+
+/*
+ * Number of edges from every node to the deepest leaf in its subtree. Uses
+ * depths as scratch space, and leaves the depths of the nodes there.
+ */
+template <typename index_t>
+void topological_height(index_t* parents, size_t n, index_t* depths, index_t* heights)
+{
+  node_depths(parents, n, depths);
+
+  auto const& w = [=](index_t i) ALWAYS_INL_L(index_t)
+  {
+    return depths[i];
+  };
+
+  auto const& max = [](index_t a, index_t b) ALWAYS_INL_L(index_t)
+  {
+    return std::max(a, b);
+  };
+
+  tree_scan(parents, n, heights, w, max);
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    heights[i] -= depths[i];
+  });
+}
+
+/*
+ * Writes all nodes to order, level by level, so every parent comes before
+ * its children. Nodes of the same depth are in index order. A sequential
+ * pass over order replaces pointer chasing by a linear sweep: forward for
+ * top-down passes, backward for bottom-up passes.
+ */
+template <typename index_t>
+void topological_order(index_t* parents, size_t n, index_t* order)
+{
+  using item_t = SortPair<index_t, index_t>;
+
+  if (n == 0) return;
+  if (n == 1)
+  {
+    order[0] = 0;
+    return;
+  }
+
+  index_t* depths = new index_t[n];
+
+  node_depths(parents, n, depths);
+
+  index_t max_depth = pmt::max_depth(depths, n);
+
+  // only sort the bits that can be set
+  unsigned n_bits = pmt::log2(size_t(max_depth) | 1U) + 1U;
+
+  item_t* aux1 = new item_t[n];
+  item_t* aux2 = new item_t[n];
+
+  auto const& f_initial = [=](size_t i) ALWAYS_INL_L(item_t)
+  {
+    return {depths[i], index_t(i)};
+  };
+
+  auto const& f_out = [=](index_t& out, item_t const& item) ALWAYS_INLINE
+  {
+    out = item.data();
+  };
+
+  radix_sort_parallel(order, aux1, aux2, n, 0U, n_bits, f_initial, f_out);
+
+  delete[] aux2;
+  delete[] aux1;
+  delete[] depths;
+}
+
+NAMESPACE_PMT_END
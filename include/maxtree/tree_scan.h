@@ -1,3 +1,5 @@
+#pragma once
+
 #include "../common.h"
 #include "../misc/edge.h"
 #include "../sort/radix_sort_parallel.h"
@@ -7,15 +9,143 @@
 #include "../parallel/iterative_select2_compact1.h"
 #include "../misc/dynamic_stack.h"
 #include "../parallel/thread_pool.h"
+#include "merge_schedule.h"
+#include <tuple>
+#include <utility>
 
 NAMESPACE_PMT
 
+template <
+  typename Index,
+  typename Lanes,
+  typename Recorder = NoMergeRecorder<Index>>
+class TreeContract;
+
+/*
+ * Contracts the tree once, and calls lanes.init(i) for every node and
+ * lanes.merge(a, b) to merge the attributes of node b to node a. merge must
+ * be associative and commutative, unless the lanes have has_pending.
+ */
+template <typename index_t, typename lanes_t>
+void tree_contract(
+  index_t* parents,
+  size_t n,
+  lanes_t const& lanes)
+{
+  NoMergeRecorder<index_t> recorder;
+
+  TreeContract<index_t, lanes_t> tc(parents, n, lanes, &recorder);
+}
+
 template <
   typename Index,
   typename Attribute,
   typename Functor1,
   typename Functor2>
-class TreeContract;
+struct ScanLane
+{
+  using index_t = Index;
+  using attribute_t = Attribute;
+  using functor1_t = Functor1;
+  using functor2_t = Functor2;
+
+  ScanLane(
+    attribute_t* attributes,
+    functor1_t const& w,
+    functor2_t const& plus) :
+    attributes_(attributes), w_(w), plus_(plus)
+  {
+  }
+
+  ALWAYS_INLINE_F void init(index_t i) const
+  {
+    attributes_[i] = w_(i);
+  }
+
+  // merge the attribute of b to a
+  ALWAYS_INLINE_F void merge(index_t a, index_t b) const
+  {
+    attributes_[a] = plus_(attributes_[a], attributes_[b]);
+  }
+
+  attribute_t* RESTRICT attributes_;
+  functor1_t const& w_;
+  functor2_t const& plus_;
+};
+
+template <
+  typename Index,
+  typename Attributes,
+  typename Functors1,
+  typename Functors2>
+struct ScanLanes;
+
+/*
+ * Several attributes, stored as separate arrays, which are computed with a
+ * single contraction.
+ */
+template <
+  typename Index,
+  typename... Attribute,
+  typename... Functor1,
+  typename... Functor2>
+struct ScanLanes<
+  Index,
+  std::tuple<Attribute*...>,
+  std::tuple<Functor1...>,
+  std::tuple<Functor2...>>
+{
+  using index_t = Index;
+  using attributes_t = std::tuple<Attribute*...>;
+  using functors1_t = std::tuple<Functor1...>;
+  using functors2_t = std::tuple<Functor2...>;
+  using lanes_t = std::index_sequence_for<Attribute...>;
+
+  static_assert(
+    sizeof...(Attribute) == sizeof...(Functor1) &&
+    sizeof...(Attribute) == sizeof...(Functor2),
+    "every attribute needs a w and a plus");
+
+  ScanLanes(
+    attributes_t const& attributes,
+    functors1_t const& w,
+    functors2_t const& plus) :
+    attributes_(attributes), w_(w), plus_(plus)
+  {
+  }
+
+  ALWAYS_INLINE_F void init(index_t i) const
+  {
+    init(i, lanes_t());
+  }
+
+  ALWAYS_INLINE_F void merge(index_t a, index_t b) const
+  {
+    merge(a, b, lanes_t());
+  }
+
+  template <size_t... lane>
+  ALWAYS_INLINE_F void init(index_t i, std::index_sequence<lane...>) const
+  {
+    using expand = int[];
+
+    (void)expand{0, (std::get<lane>(attributes_)[i] = std::get<lane>(w_)(i), 0)...};
+  }
+
+  template <size_t... lane>
+  ALWAYS_INLINE_F void merge(index_t a, index_t b, std::index_sequence<lane...>) const
+  {
+    using expand = int[];
+
+    (void)expand{0, (std::get<lane>(attributes_)[a] = std::get<lane>(plus_)(
+      std::get<lane>(attributes_)[a],
+      std::get<lane>(attributes_)[b]), 0)...};
+  }
+
+  attributes_t attributes_;
+  functors1_t const& w_;
+  functors2_t const& plus_;
+};
 
 template <
   typename index_t,
@@ -29,18 +159,112 @@ void tree_scan(
   functor1_t const& w,
   functor2_t const& plus)
 {
-  TreeContract<
+  using lane_t = ScanLane<index_t, attribute_t, functor1_t, functor2_t>;
+
+  tree_contract(parents, n, lane_t(attributes, w, plus));
+}
+
+/*
+ * tree_scan for the attributes std::get<k>(attributes), with initial values
+ * std::get<k>(w) and operators std::get<k>(plus). The edges are sorted and
+ * the tree is contracted only once for all attributes.
+ */
+template <
+  typename index_t,
+  typename... attribute_t,
+  typename... functor1_t,
+  typename... functor2_t>
+void tree_scan(
+  index_t* parents,
+  size_t n,
+  std::tuple<attribute_t*...> const& attributes,
+  std::tuple<functor1_t...> const& w,
+  std::tuple<functor2_t...> const& plus)
+{
+  using lanes_t = ScanLanes<
     index_t,
-    attribute_t,
-    functor1_t,
-    functor2_t> tc(parents, n, attributes, w, plus);
+    std::tuple<attribute_t*...>,
+    std::tuple<functor1_t...>,
+    std::tuple<functor2_t...>>;
+
+  tree_contract(parents, n, lanes_t(attributes, w, plus));
+}
+
+/*
+ * Lanes where the attribute of a node is a function of the attributes of its
+ * descendants that are not merged yet, like ViterbiLanes, set has_pending to
+ * true. Besides init and merge, which merges a complete node, they implement
+ * - attach(b, c): c is the only pending descendant of b,
+ * - merge_partial(a, b): merges b, with its pending descendant, to a, whose
+ *   only child is b,
+ * - relink(a, b, c): b, with the pending descendant c, is merged away and c
+ *   becomes a child of a,
+ * - merge_pending(a, c): merges the complete node c to a, which was merged
+ *   away with the pending descendant c.
+ * For the other lanes, these are merge or nothing.
+ */
+template <typename lanes_t, typename = void>
+struct has_pending_lanes : std::false_type {};
+
+template <typename lanes_t>
+struct has_pending_lanes<lanes_t, std::enable_if_t<lanes_t::has_pending>> :
+  std::true_type {};
+
+template <typename Index>
+struct NoLanes
+{
+  using index_t = Index;
+
+  INLINE void init(index_t i) const {}
+  INLINE void merge(index_t a, index_t b) const {}
+};
+
+/*
+ * Records the merges of tree_scan, for repeated scans of the same tree with
+ * tree_scan(schedule, attributes, w, plus).
+ */
+template <typename index_t>
+void schedule_tree_scan(
+  index_t* parents,
+  size_t n,
+  MergeSchedule<index_t>* schedule)
+{
+  using lanes_t = NoLanes<index_t>;
+  using recorder_t = MergeRecorder<index_t>;
+
+  schedule->reset(n, MergeSchedule<index_t>::bottom_up);
+
+  lanes_t lanes;
+  recorder_t recorder(schedule);
+
+  TreeContract<index_t, lanes_t, recorder_t> tc(parents, n, lanes, &recorder);
 }
 
 template <
-  typename Index,
-  typename Attribute,
-  typename Functor1,
-  typename Functor2>
+  typename index_t,
+  typename attribute_t,
+  typename functor1_t,
+  typename functor2_t>
+void tree_scan(
+  MergeSchedule<index_t> const& schedule,
+  attribute_t* attributes,
+  functor1_t const& w,
+  functor2_t const& plus)
+{
+  check(schedule.dir() == MergeSchedule<index_t>::bottom_up);
+
+  attribute_t* RESTRICT attr = attributes;
+
+  thread_pool.for_all(schedule.n(), [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    attr[i] = w(i);
+  });
+
+  schedule.replay([=](index_t a, index_t b) ALWAYS_INLINE {
+    attr[a] = plus(attr[a], attr[b]);
+  });
+}
+
+template <typename Index, typename Lanes, typename Recorder>
 class TreeContract
 {
 public:  
@@ -51,16 +275,19 @@ public:
 private:
   using index_t = Index;
   using edge_t = SortableEdgeByStart<index_t>;
-  using functor1_t = Functor1;
-  using functor2_t = Functor2;
-  using attribute_t = Attribute;
+  using lanes_t = Lanes;
+  using recorder_t = Recorder;
+  using has_pending_t = has_pending_lanes<lanes_t>;
+
+  friend void tree_contract<index_t, lanes_t>(
+    index_t* parents,
+    size_t n,
+    lanes_t const& lanes);
 
-  friend void tree_scan<index_t, attribute_t, functor1_t, functor2_t>(
-    index_t *parents,
+  friend void schedule_tree_scan<index_t>(
+    index_t* parents,
     size_t n,
-    attribute_t *attributes,
-    functor1_t const &w,
-    functor2_t const &plus);
+    MergeSchedule<index_t>* schedule);
 
   struct EdgeArray
   {
@@ -71,9 +298,8 @@ private:
   TreeContract(
     index_t* parents,
     size_t n,
-    attribute_t* attributes,
-    functor1_t const& w,
-    functor2_t const& plus);
+    lanes_t const& lanes,
+    recorder_t* recorder);
   ~TreeContract();
   
   void merge_first_excluded_descendant();
@@ -96,46 +322,96 @@ private:
     return !is_balanced(node) && !is_leaf(node);
   }
 
-  bool try_merge_and_check_if_leaf(index_t i);
+  bool try_merge_and_check_if_leaf(index_t i, thread_nr_t t);
+
+  ALWAYS_INLINE_F void merge(index_t a, index_t b, thread_nr_t t)
+  {
+    lanes_.merge(a, b);
+    recorder_.merge(a, b, t);
+  }
+
+  ALWAYS_INLINE_F void attach(index_t b, index_t c, std::true_type)
+  {
+    lanes_.attach(b, c);
+  }
+
+  ALWAYS_INLINE_F void attach(index_t b, index_t c, std::false_type)
+  {
+  }
+
+  ALWAYS_INLINE_F void merge_partial(index_t a, index_t b, thread_nr_t t, std::true_type)
+  {
+    lanes_.merge_partial(a, b);
+    recorder_.merge(a, b, t);
+  }
+
+  ALWAYS_INLINE_F void merge_partial(index_t a, index_t b, thread_nr_t t, std::false_type)
+  {
+    merge(a, b, t);
+  }
+
+  ALWAYS_INLINE_F void relink(index_t a, index_t b, index_t c, thread_nr_t t, std::true_type)
+  {
+    lanes_.relink(a, b, c);
+    recorder_.merge(a, b, t);
+  }
+
+  ALWAYS_INLINE_F void relink(index_t a, index_t b, index_t c, thread_nr_t t, std::false_type)
+  {
+    merge(a, b, t);
+  }
+
+  ALWAYS_INLINE_F void merge_pending(index_t a, index_t c, std::true_type) const
+  {
+    lanes_.merge_pending(a, c);
+  }
+
+  ALWAYS_INLINE_F void merge_pending(index_t a, index_t c, std::false_type) const
+  {
+    lanes_.merge(a, c);
+  }
+
   void contract(IterativeSelect2Compact1<index_t>* select, index_t root);
 
   index_t const* RESTRICT parents_;
   size_t n_;
-  attribute_t* RESTRICT attributes_;
   edge_t* RESTRICT forward_ = nullptr;
   edge_t* RESTRICT forward_aux_ = nullptr;
   index_t* RESTRICT edge_indices_;
   index_t* RESTRICT edge_indices_aux_;
-  index_t* RESTRICT childs_;
+  index_t* RESTRICT childs_ = nullptr;
   IntegerHash<index_t> hash_;
   typename pmt::rng<index_t>::type rand_;
   size_t n_forward_;
   size_t total_compacted_;
-  functor1_t const& w_;
-  functor2_t const& plus_;
+  lanes_t const& lanes_;
+  recorder_t& recorder_;
   std::vector<size_t> to_update_later_;
 };
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-TreeContract<index_t, attribute_t, functor1_t, functor2_t>::TreeContract(
+template <typename index_t, typename lanes_t, typename recorder_t>
+TreeContract<index_t, lanes_t, recorder_t>::TreeContract(
   index_t *parents,
   size_t n,
-  attribute_t *attributes,
-  functor1_t const& w,
-  functor2_t const& plus) :
-  parents_(parents), n_(n), attributes_(attributes), w_(w), plus_(plus)
+  lanes_t const& lanes,
+  recorder_t* recorder) :
+  parents_(parents), n_(n), lanes_(lanes), recorder_(*recorder)
 {
-  if (n <= 1) return;
+  if (n == 0) return;
+  if (n == 1)
+  {
+    lanes.init(0);
+    return;
+  }
 
   check(n <= ~index_t(0));
 
-  childs_ = new index_t[n];
-  forward_ = new edge_t[n];
-  forward_aux_ = new edge_t[n];
+  PMT_TRACE_SCOPE("TreeContract");
+  PMT_PERF_SCOPE("TreeContract");
+
+  childs_ = tracked_new<index_t>(n);
+  forward_ = tracked_new<edge_t>(n);
+  forward_aux_ = tracked_new<edge_t>(n);
 
   edge_t* sorted = sort_edges();
 
@@ -174,24 +450,16 @@ TreeContract<index_t, attribute_t, functor1_t, functor2_t>::TreeContract(
   merge_first_excluded_descendant();
 }
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-TreeContract<index_t, attribute_t, functor1_t, functor2_t>::~TreeContract()
+template <typename index_t, typename lanes_t, typename recorder_t>
+TreeContract<index_t, lanes_t, recorder_t>::~TreeContract()
 {
-  delete[] forward_aux_;
-  delete[] forward_;
-  delete[] childs_;
+  tracked_delete(forward_aux_, n_);
+  tracked_delete(forward_, n_);
+  tracked_delete(childs_, n_);
 }
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-void TreeContract<index_t, attribute_t, functor1_t, functor2_t>::
+template <typename index_t, typename lanes_t, typename recorder_t>
+void TreeContract<index_t, lanes_t, recorder_t>::
 merge_first_excluded_descendant()
 {
   index_t* indices = edge_indices_aux_ + total_compacted_;
@@ -202,17 +470,18 @@ merge_first_excluded_descendant()
 
     thread_pool.for_all(n_to_update, [=](index_t k, thread_nr_t thread_nr) ALWAYS_INLINE {
       edge_t const& edge = forward_[indices[k]];
-      attributes_[edge.a_] = plus_(attributes_[edge.a_], attributes_[edge.b_]);
+      merge_pending(edge.a_, edge.b_, has_pending_t());
+    });
+
+    recorder_.batch(n_to_update, [=](size_t k) ALWAYS_INL_L(Edge<index_t>) {
+      edge_t const& edge = forward_[indices[k]];
+      return {edge.a_, edge.b_};
     });
   }
 }
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-void TreeContract<index_t, attribute_t, functor1_t, functor2_t>::
+template <typename index_t, typename lanes_t, typename recorder_t>
+void TreeContract<index_t, lanes_t, recorder_t>::
 select_first(IterativeSelect2Compact1<index_t>* select)
 {
   auto const& flag = [=](index_t i, index_t o) ALWAYS_INL_L(bool)
@@ -235,15 +504,11 @@ select_first(IterativeSelect2Compact1<index_t>* select)
   select->item_blocks().select(flag);
 }
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-void TreeContract<index_t, attribute_t, functor1_t, functor2_t>::init()
+template <typename index_t, typename lanes_t, typename recorder_t>
+void TreeContract<index_t, lanes_t, recorder_t>::init()
 {
   thread_pool.for_all(n_, [=](index_t i, thread_nr_t thread_nr) ALWAYS_INLINE {
-    attributes_[i] = w_(i);
+    lanes_.init(i);
     childs_[i] = i;
   });
 
@@ -269,13 +534,9 @@ void TreeContract<index_t, attribute_t, functor1_t, functor2_t>::init()
   });
 }
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-typename TreeContract<index_t, attribute_t, functor1_t, functor2_t>::edge_t
-*TreeContract<index_t, attribute_t, functor1_t, functor2_t>::sort_edges()
+template <typename index_t, typename lanes_t, typename recorder_t>
+typename TreeContract<index_t, lanes_t, recorder_t>::edge_t
+*TreeContract<index_t, lanes_t, recorder_t>::sort_edges()
 {
   auto const& f_initial_item = [=](index_t i) ALWAYS_INL_L(edge_t)
   {
@@ -292,13 +553,9 @@ typename TreeContract<index_t, attribute_t, functor1_t, functor2_t>::edge_t
   return sorted;
 }
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-bool TreeContract<index_t, attribute_t, functor1_t, functor2_t>::
-try_merge_and_check_if_leaf(index_t i)
+template <typename index_t, typename lanes_t, typename recorder_t>
+bool TreeContract<index_t, lanes_t, recorder_t>::
+try_merge_and_check_if_leaf(index_t i, thread_nr_t t)
 {
   edge_t edge = forward_[i];
   //printf("try merge from %d -> %d\n", edge.a_, edge.b_);
@@ -332,12 +589,12 @@ try_merge_and_check_if_leaf(index_t i)
     {
       index_t next = stack.remove();
       childs_[next] = next;
-      attributes_[next] = plus_(attributes_[next], attributes_[tail]);
+      merge(next, tail, t);
       //merge_(next, tail);
       tail = next;        
     }
 
-    attributes_[edge.a_] = plus_(attributes_[edge.a_], attributes_[tail]);
+    merge(edge.a_, tail, t);
     //merge_(edge.a_, tail);            
     return true;
   }
@@ -345,31 +602,29 @@ try_merge_and_check_if_leaf(index_t i)
   index_t relink_node = current;
   index_t tail = stack.remove();
 
+  attach(tail, relink_node, has_pending_t());
+
   while (stack.length() > 0)
   {
     index_t next = stack.remove();
     childs_[next] = relink_node;
-    attributes_[next] = plus_(attributes_[next], attributes_[tail]);
+    merge_partial(next, tail, t, has_pending_t());
     //merge_(next, tail);
     tail = next;
   }
   
-  attributes_[edge.a_] = plus_(attributes_[edge.a_], attributes_[tail]);
+  relink(edge.a_, tail, relink_node, t, has_pending_t());
   //merge_(edge.a_, tail);
   forward_[i].b_ = relink_node;
   return false;
 }
 
 
-template <
-  typename index_t,
-  typename attribute_t,
-  typename functor1_t,
-  typename functor2_t>
-void TreeContract<index_t, attribute_t, functor1_t, functor2_t>::
+template <typename index_t, typename lanes_t, typename recorder_t>
+void TreeContract<index_t, lanes_t, recorder_t>::
 contract(IterativeSelect2Compact1<index_t>* select, index_t root)
 {
-  auto const& f = [=](index_t i)
+  auto const& f = [=](index_t i, thread_nr_t t)
   {                
     index_t edge_idx = edge_indices_[i];
     index_t start_point = forward_[edge_idx].a_;
@@ -384,7 +639,7 @@ contract(IterativeSelect2Compact1<index_t>* select, index_t root)
 
     if (is_ll_node)
     {
-      bool is_leaf = try_merge_and_check_if_leaf(edge_idx);
+      bool is_leaf = try_merge_and_check_if_leaf(edge_idx, t);
 
       if (is_leaf)
       {
@@ -399,7 +654,7 @@ contract(IterativeSelect2Compact1<index_t>* select, index_t root)
     size_t n_childs = 0;
     do
     {            
-      if (!try_merge_and_check_if_leaf(edge_idx))
+      if (!try_merge_and_check_if_leaf(edge_idx, t))
       {
         ++n_childs;
         *forward_compacting-- = forward_[edge_idx];
@@ -460,7 +715,11 @@ contract(IterativeSelect2Compact1<index_t>* select, index_t root)
   };
 
   size_t n_compacted = 0;
-  select->item_blocks().apply(f);
+  select->item_blocks().apply_with_thread_nr([=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    f(i, t);
+    recorder_.end_task(t);
+  });
+  recorder_.end_phase();
   select->iterate(edge_indices_, edge_indices_aux_ + total_compacted_, flag, &n_compacted);      
   to_update_later_.push_back(n_compacted);
   total_compacted_ += n_compacted;    
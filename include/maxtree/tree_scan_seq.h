@@ -1,3 +1,5 @@
+#pragma once
+
 #include "../common.h"
 #include "../sort/radix_sort_seq.h"
 #include "rootfix_seq.h"
@@ -19,12 +21,12 @@ void tree_scan_seq(
   index_t* root_distance = new index_t[n];
 
   auto const &rootfix_plus =
-    [](attribute_t a, attribute_t b) ALWAYS_INL_L(attribute_t)
+    [](index_t a, index_t b) ALWAYS_INL_L(index_t)
     {
       return a + 1;
     };
 
-  auto const &rootfix_w = [=](index_t i) ALWAYS_INL_L(attribute_t)
+  auto const &rootfix_w = [=](index_t i) ALWAYS_INL_L(index_t)
     {
       return 0;
     };
@@ -64,6 +66,36 @@ void tree_scan_seq(
   delete[] items;  
 }
 
+/*
+ * As above, with a topological order of the nodes, see topological_order().
+ */
+template <
+  typename index_t,
+  typename attribute_t,
+  typename functor1_t,
+  typename functor2_t>
+void tree_scan_seq(
+  index_t const* order,
+  index_t const* parents,
+  size_t n,
+  attribute_t* RESTRICT attributes,
+  functor1_t const& w,
+  functor2_t const& plus)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    attributes[i] = w(i);
+  }
+
+  for (size_t i = n; i-- > 1;)
+  {
+    index_t node = order[i];
+    index_t parent = parents[node];
+
+    attributes[parent] = plus(attributes[parent], attributes[node]);
+  }
+}
+
 
 
 
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/bits.h"
+#include "../misc/unsigned_conversion.h"
+#include "../parallel/thread_pool.h"
+#include "rootfix.h"
+#include "nearest_ancestor.h"
+#include "pattern_spectrum.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <ostream>
+#include <vector>
+
+NAMESPACE_PMT
+
+/*
+ * Node statistics of a max-tree. All histograms count level roots, the nodes
+ * of the canonical tree.
+ *
+ * level_counts[k]: level roots whose unsigned level, shifted right by
+ * level_shift, is k.
+ * depth_counts[k]: level roots with 2^k - 1 <= depth < 2^(k + 1) - 1, where
+ * the depth is the number of level roots above the node.
+ * attribute_counts[k]: level roots with
+ * attribute_thresholds[k - 1] <= attribute < attribute_thresholds[k].
+ */
+struct TreeStatistics
+{
+  size_t n_nodes = 0;
+  size_t n_level_roots = 0;
+  size_t n_regional_maxima = 0;
+  size_t max_depth = 0;
+
+  unsigned level_shift = 0;
+  std::vector<size_t> level_counts;
+  std::vector<size_t> depth_counts;
+  std::vector<double> attribute_thresholds;
+  std::vector<size_t> attribute_counts;
+
+  void write_json(std::ostream& os) const;
+  void write_csv(std::ostream& os) const;
+
+private:
+  template <typename T>
+  static void write_json_array(std::ostream& os, char const* name, std::vector<T> const& xs)
+  {
+    os << "  \"" << name << "\": [";
+
+    for (size_t k = 0; k < xs.size(); ++k)
+    {
+      os << (k == 0 ? "" : ", ") << xs[k];
+    }
+
+    os << "]";
+  }
+};
+
+inline void TreeStatistics::write_json(std::ostream& os) const
+{
+  os << "{\n";
+  os << "  \"n_nodes\": " << n_nodes << ",\n";
+  os << "  \"n_level_roots\": " << n_level_roots << ",\n";
+  os << "  \"n_regional_maxima\": " << n_regional_maxima << ",\n";
+  os << "  \"max_depth\": " << max_depth << ",\n";
+  os << "  \"level_shift\": " << level_shift << ",\n";
+  write_json_array(os, "level_counts", level_counts);
+  os << ",\n";
+  write_json_array(os, "depth_counts", depth_counts);
+  os << ",\n";
+  write_json_array(os, "attribute_thresholds", attribute_thresholds);
+  os << ",\n";
+  write_json_array(os, "attribute_counts", attribute_counts);
+  os << "\n}\n";
+}
+
+/*
+ * One row per histogram bin: histogram,bin,lower_bound,count
+ */
+inline void TreeStatistics::write_csv(std::ostream& os) const
+{
+  os << "histogram,bin,lower_bound,count\n";
+
+  for (size_t k = 0; k < level_counts.size(); ++k)
+  {
+    os << "level," << k << "," << (uint64_t(k) << level_shift) << "," << level_counts[k] << "\n";
+  }
+
+  for (size_t k = 0; k < depth_counts.size(); ++k)
+  {
+    os << "depth," << k << "," << ((uint64_t(1) << k) - 1U) << "," << depth_counts[k] << "\n";
+  }
+
+  for (size_t k = 0; k < attribute_counts.size(); ++k)
+  {
+    os << "attribute," << k << ",";
+
+    if (k == 0)
+    {
+      os << "-inf";
+    }
+    else
+    {
+      os << attribute_thresholds[k - 1U];
+    }
+
+    os << "," << attribute_counts[k] << "\n";
+  }
+}
+
+/*
+ * Collects the statistics in one parallel sweep over the nodes, with
+ * per-thread histograms that are summed afterwards. The depths and level
+ * roots are computed with rootfix beforehand.
+ *
+ * Levels are binned on their n_level_bits most significant bits, so uint8_t
+ * levels get one bin per level with the default. The attribute histogram uses
+ * the ascending thresholds, as for the pattern spectrum, and is skipped if
+ * attributes is null.
+ */
+template <typename index_t, typename value_t, typename attribute_t = index_t>
+void tree_statistics(
+  index_t* parents,
+  size_t n,
+  value_t const* values,
+  TreeStatistics* out,
+  attribute_t const* attributes = nullptr,
+  attribute_t const* thresholds = nullptr,
+  size_t n_thresholds = 0,
+  unsigned n_level_bits = 8U)
+{
+  using uvalue_t = decltype(unsigned_conversion(values[0]));
+
+  constexpr unsigned value_bits = sizeof(uvalue_t) * CHAR_BIT;
+  constexpr size_t n_depth_bins = sizeof(index_t) * CHAR_BIT + 1U;
+
+  check(n_level_bits <= 16U);
+
+  *out = TreeStatistics();
+  out->n_nodes = n;
+
+  n_level_bits = std::min(n_level_bits, value_bits);
+
+  unsigned level_shift = value_bits - n_level_bits;
+  size_t n_level_bins = size_t(1) << n_level_bits;
+  size_t n_attribute_bins = attributes == nullptr ? 0 : n_thresholds + 1U;
+
+  out->level_shift = level_shift;
+
+  if (n == 0) return;
+
+  index_t* level_roots = new index_t[n];
+  index_t* depths = new index_t[n];
+  std::atomic<uint8_t>* has_childs = new std::atomic<uint8_t>[n];
+
+  key_roots(parents, n, [=](index_t i) ALWAYS_INL_L(value_t) { return values[i]; }, level_roots);
+
+  auto const& is_level_root = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return level_roots[i] == i;
+  };
+
+  {
+    auto const& w = [=](index_t i) ALWAYS_INL_L(index_t)
+    {
+      return is_level_root(i) && parents[i] != i;
+    };
+
+    auto const& plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t)
+    {
+      return a + b;
+    };
+
+    rootfix(parents, n, depths, w, plus);
+  }
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    has_childs[i].store(0, std::memory_order_relaxed);
+  });
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    if (is_level_root(i) && parents[i] != i)
+    {
+      has_childs[level_roots[parents[i]]].store(1, std::memory_order_relaxed);
+    }
+  });
+
+  // per-thread counters and histograms, padded to avoid false sharing
+  size_t n_counters = 3U + n_level_bins + n_depth_bins + n_attribute_bins;
+  size_t stride = div_roundup(n_counters * sizeof(size_t), cacheline_len) * cacheline_len / sizeof(size_t);
+  size_t n_threads = thread_pool.max_threads();
+  size_t* histograms = new size_t[n_threads * stride];
+
+  std::fill(histograms, histograms + n_threads * stride, size_t(0));
+
+  thread_pool.for_all(n, [=](index_t i, thread_nr_t t) ALWAYS_INLINE {
+    if (!is_level_root(i)) return;
+
+    size_t* h = histograms + t * stride;
+    // the root is not counted, a level root counts itself
+    index_t depth = depths[i];
+
+    h[0] += 1U;
+    h[1] += !has_childs[i].load(std::memory_order_relaxed);
+    h[2] = std::max(h[2], size_t(depth));
+
+    size_t* level_hist = h + 3U;
+    size_t* depth_hist = level_hist + n_level_bins;
+    size_t* attribute_hist = depth_hist + n_depth_bins;
+
+    ++level_hist[size_t(unsigned_conversion(values[i])) >> level_shift];
+    ++depth_hist[pmt::log2(size_t(depth) + 1U)];
+
+    if (n_attribute_bins != 0)
+    {
+      ++attribute_hist[threshold_bin(attributes[i], thresholds, n_thresholds)];
+    }
+  });
+
+  delete[] has_childs;
+  delete[] depths;
+  delete[] level_roots;
+
+  std::vector<size_t> totals(n_counters, 0);
+
+  for (size_t t = 0; t < n_threads; ++t)
+  {
+    size_t const* h = histograms + t * stride;
+
+    totals[0] += h[0];
+    totals[1] += h[1];
+    totals[2] = std::max(totals[2], h[2]);
+
+    for (size_t k = 3; k < n_counters; ++k)
+    {
+      totals[k] += h[k];
+    }
+  }
+
+  delete[] histograms;
+
+  out->n_level_roots = totals[0];
+  out->n_regional_maxima = totals[1];
+  out->max_depth = totals[2];
+
+  auto level_begin = totals.begin() + 3;
+  auto depth_begin = level_begin + n_level_bins;
+  auto attribute_begin = depth_begin + n_depth_bins;
+
+  out->level_counts.assign(level_begin, depth_begin);
+  out->depth_counts.assign(depth_begin, depth_begin + pmt::log2(out->max_depth + 1U) + 1U);
+  out->attribute_counts.assign(attribute_begin, totals.end());
+
+  if (n_attribute_bins != 0)
+  {
+    out->attribute_thresholds.assign(thresholds, thresholds + n_thresholds);
+  }
+}
+
+NAMESPACE_PMT_END
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../common.h"
+#include <mutex>
+#include <vector>
+
+NAMESPACE_PMT
+
+/*
+ * Source of the large working buffers, which are allocated with tracked_new
+ * and tracked_malloc (memory_tracker.h). The library allocates them on the
+ * main thread, outside parallel sections. Buffers are aligned to at least
+ * alignof(std::max_align_t).
+ */
+class Allocator
+{
+public:
+  virtual ~Allocator() {}
+
+  virtual void* allocate(size_t bytes) = 0;
+  virtual void deallocate(void* p, size_t bytes) = 0;
+};
+
+/*
+ * malloc and free, the default
+ */
+class HeapAllocator : public Allocator
+{
+public:
+  void* allocate(size_t bytes) override;
+  void deallocate(void* p, size_t bytes) override;
+};
+
+/*
+ * Buffers in 2 MiB pages. Explicit huge pages (MAP_HUGETLB) are used if the
+ * system has them reserved, otherwise transparent huge pages are requested
+ * with madvise. The pages of a new mapping are touched by the threads of the
+ * thread pool, so that page faults are taken in parallel instead of during
+ * the first pass over the buffer.
+ *
+ * Deallocated buffers are cached, up to max_cached_bytes, and recycled for
+ * allocations of at least half their size; repeated max-tree computations
+ * on images of the same size then reuse faulted pages. release() unmaps the
+ * cached buffers.
+ */
+class HugePageArena : public Allocator
+{
+public:
+  static constexpr size_t page_size = size_t(1) << 21U;
+
+  HugePageArena(size_t max_cached_bytes = size_t(1) << 32U) :
+    max_cached_bytes_(max_cached_bytes)
+  {
+  }
+
+  ~HugePageArena();
+
+  HugePageArena(HugePageArena const&) = delete;
+  HugePageArena& operator=(HugePageArena const&) = delete;
+
+  void* allocate(size_t bytes) override;
+  void deallocate(void* p, size_t bytes) override;
+
+  void release();
+
+  size_t cached_bytes() const { return cached_bytes_; }
+  size_t n_mapped() const { return n_mapped_; }
+  size_t n_recycled() const { return n_recycled_; }
+  size_t n_explicit() const { return n_explicit_; }
+
+private:
+  struct Mapping
+  {
+    void* p;
+    size_t size;
+  };
+
+  void* map(size_t size);
+  void trim(size_t max_cached_bytes);
+
+  std::mutex mutex_;
+  std::vector<Mapping> cached_;
+  std::vector<Mapping> in_use_;
+  size_t max_cached_bytes_;
+  size_t cached_bytes_ = 0;
+  size_t n_mapped_ = 0;
+  size_t n_recycled_ = 0;
+  size_t n_explicit_ = 0;
+};
+
+/*
+ * The allocator of the working buffers. set_allocator(nullptr) restores the
+ * heap allocator. Buffers must be deallocated by the allocator that
+ * allocated them, so only change it between computations.
+ */
+Allocator& allocator();
+void set_allocator(Allocator* allocator);
+
+NAMESPACE_PMT_END
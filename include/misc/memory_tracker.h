@@ -0,0 +1,148 @@
+#pragma once
+
+#include "../common.h"
+#include "allocator.h"
+#include "logger.h"
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+NAMESPACE_PMT
+
+/*
+ * Accounting of the large working buffers (image sized or edge sized) of
+ * the library. They are allocated from allocator() with tracked_new or
+ * tracked_malloc and released with the same size, so that the current and
+ * peak number of bytes in use are known at any time. Small arrays (per
+ * subgraph or per partition) are not tracked.
+ *
+ * A budget of 0 bytes is unlimited. Otherwise, Maxtree chooses strategies
+ * with a lower peak when the projected peak would exceed the budget, see
+ * Maxtree::choose_memory_strategy. The budget is a target, allocations are
+ * never refused.
+ */
+class MemoryTracker
+{
+public:
+  void add(size_t bytes)
+  {
+    size_t current = current_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peak_.load(std::memory_order_relaxed);
+
+    while (current > peak &&
+      !peak_.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  void remove(size_t bytes)
+  {
+    current_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  size_t current() const { return current_.load(std::memory_order_relaxed); }
+  size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+  /*
+   * Starts a new peak measurement at the current usage
+   */
+  void reset_peak() { peak_.store(current(), std::memory_order_relaxed); }
+
+  size_t budget() const { return budget_; }
+  void set_budget(size_t bytes) { budget_ = bytes; }
+
+  /*
+   * Whether bytes more than the current usage stay within the budget
+   */
+  bool fits(size_t bytes) const
+  {
+    return budget_ == 0 || current() + bytes <= budget_;
+  }
+
+private:
+  std::atomic<size_t> current_{0};
+  std::atomic<size_t> peak_{0};
+  size_t budget_ = 0;
+};
+
+extern MemoryTracker memory_tracker;
+
+inline void* tracked_malloc(size_t bytes)
+{
+  void* p = allocator().allocate(bytes);
+
+  if (p != nullptr)
+  {
+    memory_tracker.add(bytes);
+  }
+
+  return p;
+}
+
+inline void tracked_free(void* p, size_t bytes)
+{
+  if (p == nullptr) return;
+
+  allocator().deallocate(p, bytes);
+  memory_tracker.remove(bytes);
+}
+
+template <typename T>
+std::enable_if_t<std::is_trivially_default_constructible<T>::value>
+construct_items(T* p, size_t n)
+{
+}
+
+template <typename T>
+std::enable_if_t<!std::is_trivially_default_constructible<T>::value>
+construct_items(T* p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    new (p + i) T;
+  }
+}
+
+template <typename T>
+std::enable_if_t<std::is_trivially_destructible<T>::value>
+destroy_items(T* p, size_t n)
+{
+}
+
+template <typename T>
+std::enable_if_t<!std::is_trivially_destructible<T>::value>
+destroy_items(T* p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    p[i].~T();
+  }
+}
+
+/*
+ * As new T[n] and delete[], from allocator()
+ */
+template <typename T>
+T* tracked_new(size_t n)
+{
+  static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned type");
+
+  T* p = static_cast<T*>(tracked_malloc(n * sizeof(T)));
+
+  check(p != nullptr || n == 0);
+  construct_items(p, n);
+
+  return p;
+}
+
+template <typename T>
+void tracked_delete(T* p, size_t n)
+{
+  if (p == nullptr) return;
+
+  destroy_items(p, n);
+  tracked_free(p, n * sizeof(T));
+}
+
+NAMESPACE_PMT_END
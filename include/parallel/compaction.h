@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../common.h"
+#include "thread_pool.h"
+#include "../misc/exclusive_sum.h"
+#include <algorithm>
+
+NAMESPACE_PMT
+
+/*
+ * Stable compaction of the items i in [0, n) for which flag(i) is true.
+ * count(flag) counts them per block of items and returns their number m, so
+ * that the output can be allocated, and scatter(flag, f) then calls
+ * f(i, j) for every selected item i, with j its rank in [0, m).
+ */
+class Compaction
+{
+public:
+  Compaction(size_t n, size_t n_items_per_block = default_n_items_per_block) :
+    n_(n),
+    n_items_per_block_(n_items_per_block),
+    n_blocks_(div_roundup(n, n_items_per_block)),
+    offsets_(new size_t[n_blocks_ + 1U])
+  {
+  }
+
+  ~Compaction()
+  {
+    delete[] offsets_;
+  }
+
+  Compaction(Compaction const&) = delete;
+  Compaction& operator=(Compaction const&) = delete;
+
+  template <typename flag_t>
+  size_t count(flag_t const& flag)
+  {
+    size_t n = n_;
+    size_t n_items_per_block = n_items_per_block_;
+    size_t* offsets = offsets_;
+
+    thread_pool.for_all_blocks(n_blocks_, [=](size_t b, thread_nr_t t) {
+      size_t begin = b * n_items_per_block;
+      size_t end = std::min(begin + n_items_per_block, n);
+      size_t count = 0;
+
+      for (; begin != end; ++begin)
+      {
+        count += size_t(bool(flag(begin)));
+      }
+
+      offsets[b] = count;
+    });
+
+    offsets_[n_blocks_] = 0;
+    exclusive_sum(offsets_, offsets_ + n_blocks_ + 1U);
+
+    return offsets_[n_blocks_];
+  }
+
+  template <typename flag_t, typename functor_t>
+  void scatter(flag_t const& flag, functor_t const& f) const
+  {
+    size_t n = n_;
+    size_t n_items_per_block = n_items_per_block_;
+    size_t const* offsets = offsets_;
+
+    thread_pool.for_all_blocks(n_blocks_, [=](size_t b, thread_nr_t t) {
+      size_t begin = b * n_items_per_block;
+      size_t end = std::min(begin + n_items_per_block, n);
+      size_t j = offsets[b];
+
+      for (; begin != end; ++begin)
+      {
+        if (flag(begin))
+        {
+          f(begin, j++);
+        }
+      }
+    });
+  }
+
+private:
+  size_t n_;
+  size_t n_items_per_block_;
+  size_t n_blocks_;
+  size_t* offsets_;
+};
+
+NAMESPACE_PMT_END
@@ -51,6 +51,21 @@ public:
     });
   }
 
+  // as apply, but f(i, thread_nr)
+  template <typename functor_t>
+  void apply_with_thread_nr(functor_t const& f) const
+  {
+    thread_pool.for_all_blocks(n_partitions_, [=](size_t p, thread_nr_t t) {
+      size_t b_begin = partitions_[p];
+      size_t b_end = partitions_[p + 1U];
+
+      for (size_t b = b_begin; b != b_end; ++b)
+      {
+        apply_range(b, [&](size_t i) ALWAYS_INLINE { f(i, t); });
+      }
+    });
+  }
+
   template <typename functor_t>
   void select(functor_t const& f)
   { 
@@ -3,6 +3,7 @@
 #include "../common.h"
 #include "item_blocks.h"
 #include "../misc/exclusive_sum.h"
+#include "../misc/memory_tracker.h"
 
 NAMESPACE_PMT
 
@@ -17,17 +18,19 @@ public:
   using item_t = Item;
 
   IterativeSelect2Compact1(size_t n, size_t max_block_length = 8192) :
-    item_blocks_(n, max_block_length)
+    item_blocks_(n, max_block_length),
+    n_array2_lengths_(n + 1U)
   {
-    array2_lengths = new size_t[n + 1U];
+    array2_lengths = tracked_new<size_t>(n_array2_lengths_);
     size_t n_threads = std::min(thread_pool.max_threads(), item_blocks_.n_blocks_);
-    buffers = new item_t[max_block_length * n_threads];
+    n_buffer_items_ = max_block_length * n_threads;
+    buffers = tracked_new<item_t>(n_buffer_items_);
   }
 
   ~IterativeSelect2Compact1()
   {
-    delete[] buffers;
-    delete[] array2_lengths;
+    tracked_delete(buffers, n_buffer_items_);
+    tracked_delete(array2_lengths, n_array2_lengths_);
   }
 
   size_t length() const
@@ -172,6 +175,8 @@ private:
   ItemBlocks item_blocks_;
   size_t* array2_lengths = nullptr;
   item_t* buffers = nullptr;
+  size_t n_array2_lengths_;
+  size_t n_buffer_items_ = 0;
 };
 
 NAMESPACE_PMT_END
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../common.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+NAMESPACE_PMT
+
+/*
+ * Hardware performance counters of the thread pool threads, compiled in
+ * with PMT_PERF_COUNTERS. Every thread opens its own perf_event_open
+ * counters (user space only), so no external profiler is needed. If the
+ * kernel does not allow it (perf_event_paranoid, seccomp, no PMU in a
+ * virtual machine), the counters are unavailable and all phases report
+ * zeros.
+ *
+ * A PerfScope attributes the counts of all threads between its
+ * construction and destruction to a named phase, per thread. Scopes are
+ * only created on the main thread outside parallel sections, as the
+ * counters of the other threads are read from there. Nested phases are
+ * counted inclusively.
+ */
+enum PerfCounter : unsigned
+{
+  perf_cache_misses,
+  perf_dtlb_misses,
+  perf_branch_misses,
+  n_perf_counters
+};
+
+inline char const* perf_counter_name(unsigned counter)
+{
+  static char const* names[n_perf_counters] = {
+    "cache-misses",
+    "dTLB-load-misses",
+    "branch-misses"};
+
+  return names[counter];
+}
+
+class PerfCounters
+{
+public:
+  struct Phase
+  {
+    std::string name;
+    size_t n_calls;
+    // n_threads * n_perf_counters counts
+    std::vector<uint64_t> counts;
+
+    uint64_t count(size_t thread_nr, unsigned counter) const
+    {
+      return counts[thread_nr * n_perf_counters + counter];
+    }
+
+    uint64_t total(unsigned counter) const;
+  };
+
+  PerfCounters() {}
+  ~PerfCounters();
+
+  PerfCounters(PerfCounters const&) = delete;
+  PerfCounters& operator=(PerfCounters const&) = delete;
+
+  /*
+   * Opens the counters on all threads of the thread pool. Called by the
+   * first scope, returns whether any counter could be opened.
+   */
+  bool open();
+  bool available() const { return available_; }
+  size_t n_threads() const { return max_threads_; }
+
+  std::vector<Phase> const& phases() const { return phases_; }
+  void clear() { phases_.clear(); }
+
+  /*
+   * Current values of all counters: n_threads * n_perf_counters values
+   */
+  void read(uint64_t* values) const;
+
+  void add(char const* name, uint64_t const* begin, uint64_t const* end);
+
+  /*
+   * One line per phase with the totals over the threads, in the format of
+   * Timer, or one line per phase and thread if per_thread is set
+   */
+  void report(bool per_thread = false) const;
+  void write_csv(std::ostream& os) const;
+
+private:
+  size_t max_threads_ = 0;
+  int* fds_ = nullptr;
+  bool opened_ = false;
+  bool available_ = false;
+  std::vector<Phase> phases_;
+};
+
+class PerfScope
+{
+public:
+  PerfScope(PerfCounters& counters, char const* name);
+  ~PerfScope();
+
+  PerfScope(PerfScope const&) = delete;
+  PerfScope& operator=(PerfScope const&) = delete;
+
+private:
+  PerfCounters& counters_;
+  char const* name_;
+  uint64_t* begin_;
+};
+
+#ifdef PMT_PERF_COUNTERS
+extern PerfCounters perf_counters;
+
+#define PMT_PERF_SCOPE(name) PerfScope pmt_perf_scope_(perf_counters, name)
+#else
+#define PMT_PERF_SCOPE(name)
+#endif
+
+NAMESPACE_PMT_END
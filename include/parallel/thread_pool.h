@@ -9,6 +9,8 @@
 #include "../common.h"
 #include "../misc/range.h"
 #include "../misc/random.h"
+#include "trace.h"
+#include "perf_counters.h"
 
 NAMESPACE_PMT
 
@@ -53,6 +55,19 @@ public:
     n_active_threads_ = n;
   }  
 
+#ifdef PMT_STATS
+  /*
+   * Time spent in parallel sections, in total and per thread running user
+   * functions, since the last reset
+   */
+  void reset_stats();
+  double parallel_seconds() const { return parallel_seconds_; }
+  double busy_seconds(thread_nr_t thread_nr) const
+  {
+    return thread_data_[thread_nr].data_.busy_seconds_;
+  }
+#endif
+
 private:
   enum state {running, terminating};
 
@@ -64,6 +79,9 @@ private:
 #ifdef PMT_DEBUG
     size_t concurr_reads_;
     size_t concurr_writes_;
+#endif
+#ifdef PMT_STATS
+    double busy_seconds_;
 #endif
     bool flag_;
     thread_nr_t thread_nr_;
@@ -108,6 +126,9 @@ private:
   void* user_data_{nullptr};
   cpu_set_t cpu_set_;
   pthread_attr_t pthread_attr_;  
+#ifdef PMT_STATS
+  double parallel_seconds_{0};
+#endif
 };
 
 template <typename functor_t>
@@ -150,6 +171,9 @@ void ThreadPool::for_all_blocks(
   if (n_blocks == 1U)
   {
     vec_t v = vec_t::from_index(index_t(0), grid_dims);
+#ifdef PMT_TRACE
+    TraceSpan span(tracer, 0U, trace_block);
+#endif
     user_block_f(v, 0U);
     return;
   }
@@ -163,6 +187,9 @@ void ThreadPool::for_all_blocks(
 
     for (; begin < end; ++begin)
     {
+#ifdef PMT_TRACE
+      TraceSpan span(tracer, 0U, trace_block);
+#endif
       user_block_f(v, 0U);
       v.inc_index(grid_dims);
     }
@@ -216,6 +243,9 @@ void ThreadPool::for_all_blocks(
       }
 
       vec_t v = vec_t::from_index(block_nr, data.grid_dims_);
+#ifdef PMT_TRACE
+      TraceSpan span(tracer, thread_nr, trace_block);
+#endif
       data.user_block_f_(v, thread_nr);
     }
   };
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "../common.h"
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+NAMESPACE_PMT
+
+/*
+ * Timeline tracing of the thread pool, compiled in with PMT_TRACE. Every
+ * thread writes spans into its own ring buffer: the blocks it runs, and for
+ * the main thread the barrier wait at the end of a parallel section. Spans
+ * get the label of the innermost TraceScope on the main thread, which the
+ * parallel algorithms set with PMT_TRACE_SCOPE.
+ *
+ * A ring buffer has a single writer and keeps the most recent events, so
+ * recording never blocks. There is room for a buffer per thread up to
+ * default_max_threads_limit, which bounds the threads of any thread pool.
+ * Buffers are read with write_chrome_trace after the parallel sections have
+ * finished, and the output can be loaded in chrome://tracing or Perfetto.
+ */
+enum TraceKind : uint8_t
+{
+  trace_block,
+  trace_barrier
+};
+
+struct TraceEvent
+{
+  char const* label;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  TraceKind kind;
+};
+
+class TraceBuffer
+{
+public:
+  static constexpr size_t capacity = size_t(1) << 14U;
+
+  void record(TraceEvent const& event)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+
+    events_[head & (capacity - 1U)] = event;
+    head_.store(head + 1U, std::memory_order_release);
+  }
+
+  void clear() { head_.store(0, std::memory_order_relaxed); }
+
+  size_t n_recorded() const { return head_.load(std::memory_order_acquire); }
+
+  /*
+   * The retained events in recording order
+   */
+  template <typename functor_t>
+  void apply(functor_t const& f) const
+  {
+    size_t head = n_recorded();
+    size_t begin = head > capacity ? head - capacity : 0;
+
+    for (; begin != head; ++begin)
+    {
+      f(events_[begin & (capacity - 1U)]);
+    }
+  }
+
+private:
+  std::atomic<size_t> head_{0};
+  TraceEvent events_[capacity];
+};
+
+class Tracer
+{
+public:
+  Tracer(size_t max_threads);
+  ~Tracer();
+
+  Tracer(Tracer const&) = delete;
+  Tracer& operator=(Tracer const&) = delete;
+
+  uint64_t now() const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_).count();
+  }
+
+  /*
+   * The buffer of a thread is allocated by that thread at its first event
+   */
+  void record(thread_nr_t thread_nr, TraceKind kind, uint64_t begin_ns)
+  {
+    if (thread_nr >= max_threads_) return;
+
+    if (buffers_[thread_nr] == nullptr)
+    {
+      buffers_[thread_nr] = new TraceBuffer;
+    }
+
+    buffers_[thread_nr]->record({label_, begin_ns, now(), kind});
+  }
+
+  /*
+   * Only called by the main thread, outside parallel sections
+   */
+  char const* label() const { return label_; }
+  void set_label(char const* label) { label_ = label; }
+
+  void clear();
+  void write_chrome_trace(std::ostream& os) const;
+
+private:
+  size_t max_threads_;
+  TraceBuffer** buffers_;
+  char const* label_ = "unlabelled";
+  std::chrono::steady_clock::time_point start_;
+};
+
+/*
+ * Labels the parallel sections in its scope
+ */
+class TraceScope
+{
+public:
+  TraceScope(Tracer& tracer, char const* label);
+  ~TraceScope() { tracer_.set_label(previous_); }
+
+private:
+  Tracer& tracer_;
+  char const* previous_;
+};
+
+/*
+ * Records a span from its construction to its destruction
+ */
+class TraceSpan
+{
+public:
+  TraceSpan(Tracer& tracer, thread_nr_t thread_nr, TraceKind kind) :
+    tracer_(tracer),
+    begin_ns_(tracer.now()),
+    thread_nr_(thread_nr),
+    kind_(kind)
+  {
+  }
+
+  ~TraceSpan() { tracer_.record(thread_nr_, kind_, begin_ns_); }
+
+private:
+  Tracer& tracer_;
+  uint64_t begin_ns_;
+  thread_nr_t thread_nr_;
+  TraceKind kind_;
+};
+
+inline TraceScope::TraceScope(Tracer& tracer, char const* label) :
+  tracer_(tracer),
+  previous_(tracer.label())
+{
+  tracer_.set_label(label);
+}
+
+#ifdef PMT_TRACE
+extern Tracer tracer;
+
+#define PMT_TRACE_SCOPE(label) TraceScope pmt_trace_scope_(tracer, label)
+#else
+#define PMT_TRACE_SCOPE(label)
+#endif
+
+NAMESPACE_PMT_END
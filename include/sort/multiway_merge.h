@@ -0,0 +1,166 @@
+#pragma once
+
+#include "../common.h"
+#include "../misc/logger.h"
+#include "../misc/bits.h"
+#include <limits>
+
+NAMESPACE_PMT
+
+/*
+ * Sets pos[r] such that runs [begins[r], begins[r] + pos[r]) together hold
+ * the rank smallest items of the k sorted runs [begins[r], ends[r]). Items
+ * with the value at the split are taken from the first runs first.
+ */
+template <typename item_t>
+void multiway_split(
+  item_t const* const* begins,
+  item_t const* const* ends,
+  size_t k,
+  size_t rank,
+  size_t* pos)
+{
+  using uvalue_t = typename item_t::uvalue_t;
+
+  auto const& lower_bound = [](item_t const* begin, item_t const* end, uvalue_t v) {
+    return std::partition_point(begin, end, [=](item_t const& item) {
+      return item.unsigned_value() < v;
+    });
+  };
+
+  auto const& upper_bound = [](item_t const* begin, item_t const* end, uvalue_t v) {
+    return std::partition_point(begin, end, [=](item_t const& item) {
+      return item.unsigned_value() <= v;
+    });
+  };
+
+  auto const& count_le = [&](uvalue_t v) {
+    size_t count = 0;
+
+    for (size_t r = 0; r < k; ++r)
+    {
+      count += upper_bound(begins[r], ends[r], v) - begins[r];
+    }
+
+    return count;
+  };
+
+  // the smallest value v with at least rank items <= v
+  uvalue_t lo = 0;
+  uvalue_t hi = std::numeric_limits<uvalue_t>::max();
+
+  while (lo < hi)
+  {
+    uvalue_t mid = lo + (hi - lo) / 2U;
+
+    if (count_le(mid) >= rank)
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1U;
+    }
+  }
+
+  size_t remaining = rank;
+
+  for (size_t r = 0; r < k; ++r)
+  {
+    pos[r] = lower_bound(begins[r], ends[r], lo) - begins[r];
+    remaining -= pos[r];
+  }
+
+  for (size_t r = 0; r < k && remaining > 0; ++r)
+  {
+    size_t n_equal = upper_bound(begins[r] + pos[r], ends[r], lo) - (begins[r] + pos[r]);
+    size_t take = std::min(n_equal, remaining);
+
+    pos[r] += take;
+    remaining -= take;
+  }
+
+  debug(remaining == 0);
+}
+
+/*
+ * Merges k sorted runs [begins[r], ends[r]) with a tree of losers, calling
+ * f_out(out[i], item) for the i-th smallest item. The merge is not stable.
+ */
+template <typename item_t, typename out_t, typename out_f>
+void multiway_merge(
+  item_t const* const* begins,
+  item_t const* const* ends,
+  size_t k,
+  out_t* out,
+  out_f const& f_out)
+{
+  if (k == 0) return;
+
+  size_t n_leaves = size_t(1) << log2(k);
+
+  if (n_leaves < k)
+  {
+    n_leaves *= 2U;
+  }
+
+  item_t const** heads = new item_t const*[2U * n_leaves];
+  item_t const** run_ends = heads + n_leaves;
+  size_t* tree = new size_t[2U * n_leaves];
+  size_t* winners = tree + n_leaves;
+  size_t n = 0;
+
+  for (size_t r = 0; r < n_leaves; ++r)
+  {
+    heads[r] = r < k ? begins[r] : nullptr;
+    run_ends[r] = r < k ? ends[r] : nullptr;
+    n += run_ends[r] - heads[r];
+  }
+
+  // an exhausted run loses from every other run
+  auto const& less = [=](size_t a, size_t b) ALWAYS_INL_L(bool) {
+    if (heads[a] == run_ends[a]) return false;
+    if (heads[b] == run_ends[b]) return true;
+
+    return heads[a]->unsigned_value() < heads[b]->unsigned_value();
+  };
+
+  // winners[j] is the winner of subtree j, with the leaves at n_leaves + r
+  auto const& winner = [=](size_t j) {
+    return j >= n_leaves ? j - n_leaves : winners[j];
+  };
+
+  for (size_t j = n_leaves; j-- > 1U;)
+  {
+    size_t a = winner(2U * j);
+    size_t b = winner(2U * j + 1U);
+
+    if (less(b, a))
+    {
+      std::swap(a, b);
+    }
+
+    winners[j] = a;
+    tree[j] = b;
+  }
+
+  size_t w = winner(1U);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    f_out(out[i], *heads[w]++);
+
+    for (size_t j = (n_leaves + w) / 2U; j > 0; j /= 2U)
+    {
+      if (less(tree[j], w))
+      {
+        std::swap(tree[j], w);
+      }
+    }
+  }
+
+  delete[] tree;
+  delete[] heads;
+}
+
+NAMESPACE_PMT_END
@@ -0,0 +1,409 @@
+#pragma once
+
+#include "../common.h"
+#include "sort.h"
+#include "../misc/logger.h"
+#include "../misc/exclusive_sum.h"
+#include "../parallel/thread_pool.h"
+#include "../parallel/trace.h"
+#include "../parallel/perf_counters.h"
+#include <atomic>
+#include <utility>
+
+NAMESPACE_PMT
+
+/*
+ * In-place MSD radix sort on unsigned_value(), for when radix_sort_parallel
+ * with its two auxiliary arrays does not fit in memory. The sort is not
+ * stable.
+ *
+ * A range is distributed over the buckets of its top digit in parallel with
+ * the rounds of PARADIS (Cho et al., 2015): the unplaced part of every
+ * bucket is split into a stripe per logical thread, every logical thread
+ * permutes items between its own stripes only, and a repair step per bucket
+ * moves the items that could not be placed behind the placed ones. What
+ * remains after a few rounds is placed with a sequential American flag
+ * sort. Buckets larger than a thread's share are sorted the same way, the
+ * others are sorted sequentially, in parallel.
+ */
+template <typename Item>
+class RadixSortInPlace
+{
+public:
+  static constexpr unsigned histo_sz = 1U << histo_sz_log2;
+  static constexpr unsigned histo_mask = histo_sz - 1U;
+  static constexpr size_t min_parallel_length = size_t(1) << 16U;
+  static constexpr size_t insertion_sort_length = 32U;
+  static constexpr unsigned max_rounds = 8U;
+
+  using item_t = Item;
+  using uvalue_t = typename Item::uvalue_t;
+
+  RadixSortInPlace(item_t* items, size_t n, size_t n_stripes) :
+    items_(items),
+    n_stripes_(n_stripes),
+    top_shift_((radix_sort_n_digits<uvalue_t>() - 1U) * histo_sz_log2)
+  {
+    PMT_TRACE_SCOPE("RadixSortInPlace");
+    PMT_PERF_SCOPE("RadixSortInPlace");
+
+    sort_parallel(0, n, top_shift_);
+  }
+
+  // the deepest digit level that was sorted, 1 for the top digit
+  unsigned n_levels() const { return n_levels_.load(std::memory_order_relaxed); }
+
+private:
+  ALWAYS_INLINE_F void add_level(unsigned shift)
+  {
+    unsigned level = (top_shift_ - shift) / histo_sz_log2 + 1U;
+    unsigned n_levels = n_levels_.load(std::memory_order_relaxed);
+
+    while (level > n_levels &&
+      !n_levels_.compare_exchange_weak(n_levels, level, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  ALWAYS_INLINE_F unsigned digit(size_t i, unsigned shift) const
+  {
+    return unsigned(items_[i].unsigned_value() >> shift) & histo_mask;
+  }
+
+  void sort_parallel(size_t begin, size_t end, unsigned shift);
+  void sort_sequential(size_t begin, size_t end, unsigned shift);
+  void histogram_parallel(size_t begin, size_t end, unsigned shift, size_t* bucket_ends);
+  void distribute_parallel(size_t* heads, size_t const* ends, unsigned shift);
+  void repair(size_t b, size_t const* stripe_begins, size_t const* stripe_heads,
+    size_t const* stripe_ends, size_t* heads);
+  void permute(size_t* heads, size_t const* ends, unsigned shift);
+
+  item_t* RESTRICT items_;
+  size_t n_stripes_;
+  unsigned top_shift_;
+  std::atomic<unsigned> n_levels_{0};
+};
+
+/*
+ * n_stripes is the number of logical threads in the distribution rounds,
+ * 0 for the active threads of the thread pool. Returns the number of digit
+ * levels that were sorted, each of which is at most a pass over the items.
+ */
+template <typename item_t>
+unsigned radix_sort_in_place(item_t* items, size_t n, size_t n_stripes = 0)
+{
+  if (n <= 1) return 0;
+
+  if (n_stripes == 0)
+  {
+    n_stripes = thread_pool.n_active_threads();
+  }
+
+  RadixSortInPlace<item_t> sorter(items, n, n_stripes);
+
+  return sorter.n_levels();
+}
+
+template <typename item_t>
+void RadixSortInPlace<item_t>::sort_parallel(size_t begin, size_t end, unsigned shift)
+{
+  size_t n = end - begin;
+
+  if (n_stripes_ <= 1 || n < min_parallel_length)
+  {
+    sort_sequential(begin, end, shift);
+    return;
+  }
+
+  add_level(shift);
+
+  size_t heads[histo_sz];
+  size_t ends[histo_sz + 1U];
+
+  histogram_parallel(begin, end, shift, ends);
+
+  for (unsigned b = 0; b < histo_sz; ++b)
+  {
+    heads[b] = b == 0 ? begin : ends[b - 1U];
+  }
+
+  distribute_parallel(heads, ends, shift);
+
+  // whatever the rounds left unplaced
+  permute(heads, ends, shift);
+
+  if (shift == 0) return;
+
+  size_t large = n / n_stripes_;
+
+  for (unsigned b = 0; b < histo_sz; ++b)
+  {
+    size_t b_begin = b == 0 ? begin : ends[b - 1U];
+
+    if (ends[b] - b_begin > large)
+    {
+      sort_parallel(b_begin, ends[b], shift - histo_sz_log2);
+    }
+  }
+
+  thread_pool.for_all_blocks(histo_sz, [&](size_t b, thread_nr_t t) {
+    size_t b_begin = b == 0 ? begin : ends[b - 1U];
+
+    if (ends[b] - b_begin <= large)
+    {
+      sort_sequential(b_begin, ends[b], shift - histo_sz_log2);
+    }
+  });
+}
+
+/*
+ * American flag sort, with insertion sort for short ranges
+ */
+template <typename item_t>
+void RadixSortInPlace<item_t>::sort_sequential(size_t begin, size_t end, unsigned shift)
+{
+  add_level(shift);
+
+  if (end - begin <= insertion_sort_length)
+  {
+    for (size_t i = begin + 1U; i < end; ++i)
+    {
+      item_t item = items_[i];
+      size_t j = i;
+
+      for (; j > begin && items_[j - 1U].unsigned_value() > item.unsigned_value(); --j)
+      {
+        items_[j] = items_[j - 1U];
+      }
+
+      items_[j] = item;
+    }
+
+    return;
+  }
+
+  size_t heads[histo_sz];
+  size_t ends[histo_sz];
+
+  std::fill(ends, ends + histo_sz, size_t(0));
+
+  for (size_t i = begin; i < end; ++i)
+  {
+    ++ends[digit(i, shift)];
+  }
+
+  size_t offset = begin;
+
+  for (unsigned b = 0; b < histo_sz; ++b)
+  {
+    heads[b] = offset;
+    offset += ends[b];
+    ends[b] = offset;
+  }
+
+  permute(heads, ends, shift);
+
+  if (shift == 0) return;
+
+  for (unsigned b = 0; b < histo_sz; ++b)
+  {
+    size_t b_begin = b == 0 ? begin : ends[b - 1U];
+
+    if (ends[b] - b_begin > 1U)
+    {
+      sort_sequential(b_begin, ends[b], shift - histo_sz_log2);
+    }
+  }
+}
+
+/*
+ * ends[b] is set to the end of bucket b
+ */
+template <typename item_t>
+void RadixSortInPlace<item_t>::histogram_parallel(
+  size_t begin,
+  size_t end,
+  unsigned shift,
+  size_t* bucket_ends)
+{
+  size_t n_chunks = div_roundup(end - begin, default_n_items_per_block);
+  size_t* counts = new size_t[n_chunks * histo_sz];
+
+  thread_pool.for_all_blocks(n_chunks, [=](size_t c, thread_nr_t t) {
+    size_t* histo = counts + c * histo_sz;
+    size_t i = begin + c * default_n_items_per_block;
+    size_t i_end = std::min(i + default_n_items_per_block, end);
+
+    std::fill(histo, histo + histo_sz, size_t(0));
+
+    for (; i < i_end; ++i)
+    {
+      ++histo[digit(i, shift)];
+    }
+  });
+
+  size_t offset = begin;
+
+  for (unsigned b = 0; b < histo_sz; ++b)
+  {
+    for (size_t c = 0; c < n_chunks; ++c)
+    {
+      offset += counts[c * histo_sz + b];
+    }
+
+    bucket_ends[b] = offset;
+  }
+
+  delete[] counts;
+}
+
+/*
+ * Rounds of speculative permutation within the stripes and repair, until
+ * less than half of the unplaced items get placed in a round
+ */
+template <typename item_t>
+void RadixSortInPlace<item_t>::distribute_parallel(
+  size_t* heads,
+  size_t const* ends,
+  unsigned shift)
+{
+  size_t n_stripes = n_stripes_;
+  size_t* stripe_begins = new size_t[3U * n_stripes * histo_sz];
+  size_t* stripe_heads = stripe_begins + n_stripes * histo_sz;
+  size_t* stripe_ends = stripe_heads + n_stripes * histo_sz;
+
+  auto const& n_unplaced = [&]() {
+    size_t count = 0;
+
+    for (unsigned b = 0; b < histo_sz; ++b)
+    {
+      count += ends[b] - heads[b];
+    }
+
+    return count;
+  };
+
+  size_t unplaced = n_unplaced();
+
+  for (unsigned round = 0; round < max_rounds && unplaced >= min_parallel_length; ++round)
+  {
+    for (size_t s = 0; s < n_stripes; ++s)
+    {
+      for (unsigned b = 0; b < histo_sz; ++b)
+      {
+        size_t length = ends[b] - heads[b];
+        size_t k = s * histo_sz + b;
+
+        stripe_begins[k] = heads[b] + length * s / n_stripes;
+        stripe_heads[k] = stripe_begins[k];
+        stripe_ends[k] = heads[b] + length * (s + 1U) / n_stripes;
+      }
+    }
+
+    thread_pool.for_all_blocks(n_stripes, [=](size_t s, thread_nr_t t) {
+      permute(stripe_heads + s * histo_sz, stripe_ends + s * histo_sz, shift);
+    });
+
+    thread_pool.for_all_blocks(histo_sz, [=](size_t b, thread_nr_t t) {
+      repair(b, stripe_begins, stripe_heads, stripe_ends, heads);
+    });
+
+    size_t remaining = n_unplaced();
+    bool slow = 2U * remaining > unplaced;
+
+    unplaced = remaining;
+
+    if (slow) break;
+  }
+
+  delete[] stripe_begins;
+}
+
+/*
+ * Moves the items placed in the stripes of bucket b in front of the
+ * unplaced ones, by swapping unplaced items in front of the new head with
+ * placed items behind it, and advances the head of b
+ */
+template <typename item_t>
+void RadixSortInPlace<item_t>::repair(
+  size_t b,
+  size_t const* stripe_begins,
+  size_t const* stripe_heads,
+  size_t const* stripe_ends,
+  size_t* heads)
+{
+  size_t n_stripes = n_stripes_;
+  size_t n_placed = 0;
+
+  for (size_t s = 0; s < n_stripes; ++s)
+  {
+    n_placed += stripe_heads[s * histo_sz + b] - stripe_begins[s * histo_sz + b];
+  }
+
+  size_t head = heads[b] + n_placed;
+
+  // unplaced items in increasing order, placed items in decreasing order
+  size_t u_stripe = 0;
+  size_t u = stripe_heads[b];
+  size_t p_stripe = n_stripes - 1U;
+  size_t p = stripe_heads[p_stripe * histo_sz + b];
+
+  while (true)
+  {
+    while (u_stripe < n_stripes && u == stripe_ends[u_stripe * histo_sz + b])
+    {
+      if (++u_stripe < n_stripes)
+      {
+        u = stripe_heads[u_stripe * histo_sz + b];
+      }
+    }
+
+    if (u_stripe == n_stripes || u >= head) break;
+
+    while (p == stripe_begins[p_stripe * histo_sz + b])
+    {
+      --p_stripe;
+      p = stripe_heads[p_stripe * histo_sz + b];
+    }
+
+    --p;
+    debug(p >= head);
+    std::swap(items_[u], items_[p]);
+    ++u;
+  }
+
+  heads[b] = head;
+}
+
+/*
+ * Cycle leader permutation of the unplaced items in [heads[b], ends[b]) of
+ * all buckets b. An item that belongs in a bucket without space left stays
+ * where it is, and the rest of its bucket is skipped. If the ranges hold
+ * exactly the unplaced items of every bucket, all items are placed.
+ */
+template <typename item_t>
+void RadixSortInPlace<item_t>::permute(size_t* heads, size_t const* ends, unsigned shift)
+{
+  for (unsigned b = 0; b < histo_sz; ++b)
+  {
+    while (heads[b] < ends[b])
+    {
+      item_t item = items_[heads[b]];
+      unsigned v = unsigned(item.unsigned_value() >> shift) & histo_mask;
+
+      while (v != b && heads[v] < ends[v])
+      {
+        std::swap(item, items_[heads[v]++]);
+        v = unsigned(item.unsigned_value() >> shift) & histo_mask;
+      }
+
+      items_[heads[b]] = item;
+
+      if (v != b) break;
+
+      ++heads[b];
+    }
+  }
+}
+
+NAMESPACE_PMT_END
@@ -7,6 +7,7 @@
 #include "../parallel/thread_pool.h"
 #include "../misc/range.h"
 #include "../misc/timer.h"
+#include "../misc/memory_tracker.h"
 
 NAMESPACE_PMT
 
@@ -52,14 +53,17 @@ public:
     f_last_item_(f_last_item),
     bits_{bit_start, bit_end}    
   {    
-    global_offsets_ = new histogram_t[n_blocks()];
+    PMT_TRACE_SCOPE("RadixSortParallel");
+    PMT_PERF_SCOPE("RadixSortParallel");
+
+    global_offsets_ = tracked_new<histogram_t>(n_blocks());
 
     sort_digits();
   }
 
   ~RadixSortParallel()
   {
-    delete[] global_offsets_;
+    tracked_delete(global_offsets_, n_blocks());
   }
 
 private:
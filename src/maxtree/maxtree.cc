@@ -0,0 +1,7 @@
+#include "../../include/maxtree/maxtree.h"
+
+NAMESPACE_PMT
+
+edge_sort_t edge_sort = edge_sort_radix;
+
+NAMESPACE_PMT_END
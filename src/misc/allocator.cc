@@ -0,0 +1,194 @@
+#include "../../include/misc/allocator.h"
+#include "../../include/misc/logger.h"
+#include "../../include/parallel/thread_pool.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdlib>
+
+NAMESPACE_PMT
+
+constexpr size_t HugePageArena::page_size;
+
+static HeapAllocator heap_allocator;
+static Allocator* current_allocator = &heap_allocator;
+
+Allocator& allocator()
+{
+  return *current_allocator;
+}
+
+void set_allocator(Allocator* allocator)
+{
+  current_allocator = allocator == nullptr ? &heap_allocator : allocator;
+}
+
+void* HeapAllocator::allocate(size_t bytes)
+{
+  return malloc(bytes);
+}
+
+void HeapAllocator::deallocate(void* p, size_t bytes)
+{
+  free(p);
+}
+
+HugePageArena::~HugePageArena()
+{
+  release();
+
+  if (!in_use_.empty())
+  {
+    warn(in_use_.size() << " buffers of a huge page arena are still in use");
+  }
+}
+
+void* HugePageArena::allocate(size_t bytes)
+{
+  if (bytes == 0) return nullptr;
+
+  size_t size = div_roundup(bytes, page_size) * page_size;
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // the smallest cached buffer that is not more than twice too large
+  size_t best = cached_.size();
+
+  for (size_t i = 0; i < cached_.size(); ++i)
+  {
+    size_t cached_size = cached_[i].size;
+
+    if (cached_size >= size && cached_size <= 2U * size &&
+      (best == cached_.size() || cached_size < cached_[best].size))
+    {
+      best = i;
+    }
+  }
+
+  if (best != cached_.size())
+  {
+    Mapping m = cached_[best];
+
+    cached_[best] = cached_.back();
+    cached_.pop_back();
+    cached_bytes_ -= m.size;
+    in_use_.push_back(m);
+    ++n_recycled_;
+
+    return m.p;
+  }
+
+  void* p = map(size);
+
+  if (p == nullptr) return nullptr;
+
+  in_use_.push_back({p, size});
+  ++n_mapped_;
+
+  return p;
+}
+
+void HugePageArena::deallocate(void* p, size_t bytes)
+{
+  if (p == nullptr) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (size_t i = 0; i < in_use_.size(); ++i)
+  {
+    if (in_use_[i].p == p)
+    {
+      cached_.push_back(in_use_[i]);
+      cached_bytes_ += in_use_[i].size;
+      in_use_[i] = in_use_.back();
+      in_use_.pop_back();
+      trim(max_cached_bytes_);
+
+      return;
+    }
+  }
+
+  err("deallocating a buffer that is not in the huge page arena");
+}
+
+void HugePageArena::release()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  trim(0);
+}
+
+/*
+ * Unmaps the largest cached buffers first
+ */
+void HugePageArena::trim(size_t max_cached_bytes)
+{
+  while (cached_bytes_ > max_cached_bytes)
+  {
+    size_t largest = 0;
+
+    for (size_t i = 1; i < cached_.size(); ++i)
+    {
+      if (cached_[i].size > cached_[largest].size)
+      {
+        largest = i;
+      }
+    }
+
+    munmap(cached_[largest].p, cached_[largest].size);
+    cached_bytes_ -= cached_[largest].size;
+    cached_[largest] = cached_.back();
+    cached_.pop_back();
+  }
+}
+
+void* HugePageArena::map(size_t size)
+{
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  // fails unless huge pages are reserved, e.g. in /proc/sys/vm/nr_hugepages
+  p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+#endif
+
+  if (p != MAP_FAILED)
+  {
+    ++n_explicit_;
+  }
+  else
+  {
+    // transparent huge pages need a mapping aligned to the huge page size
+    size_t padded = size + page_size;
+    char* q = static_cast<char*>(
+      mmap(nullptr, padded, PROT_READ | PROT_WRITE, flags, -1, 0));
+
+    if (q == MAP_FAILED) return nullptr;
+
+    size_t head = (page_size - uintptr_t(q) % page_size) % page_size;
+
+    if (head > 0)
+    {
+      munmap(q, head);
+    }
+
+    munmap(q + head + size, page_size - head);
+    p = q + head;
+
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  // pre-fault in parallel, a write per base page and a block per huge page,
+  // in case transparent huge pages are not available
+  char* bytes = static_cast<char*>(p);
+  size_t base_page_size = size_t(sysconf(_SC_PAGESIZE));
+
+  thread_pool.for_all(size / base_page_size, [=](size_t i, thread_nr_t t) ALWAYS_INLINE {
+    bytes[i * base_page_size] = 0;
+  }, page_size / base_page_size);
+
+  return p;
+}
+
+NAMESPACE_PMT_END
@@ -0,0 +1,7 @@
+#include "../../include/misc/memory_tracker.h"
+
+NAMESPACE_PMT
+
+MemoryTracker memory_tracker;
+
+NAMESPACE_PMT_END
@@ -0,0 +1,218 @@
+#ifdef PMT_PERF_COUNTERS
+
+#include "../../include/parallel/perf_counters.h"
+#include "../../include/parallel/thread_pool.h"
+#include "../../include/misc/logger.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+NAMESPACE_PMT
+
+PerfCounters perf_counters;
+
+static int open_counter(uint32_t type, uint64_t config)
+{
+  perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // the calling thread, on any cpu
+  return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+uint64_t PerfCounters::Phase::total(unsigned counter) const
+{
+  uint64_t sum = 0;
+
+  for (size_t i = counter; i < counts.size(); i += n_perf_counters)
+  {
+    sum += counts[i];
+  }
+
+  return sum;
+}
+
+PerfCounters::~PerfCounters()
+{
+  for (size_t i = 0; i < max_threads_ * n_perf_counters; ++i)
+  {
+    if (fds_[i] >= 0)
+    {
+      close(fds_[i]);
+    }
+  }
+
+  delete[] fds_;
+}
+
+bool PerfCounters::open()
+{
+  if (opened_) return available_;
+
+  opened_ = true;
+  max_threads_ = thread_pool.max_threads();
+  fds_ = new int[max_threads_ * n_perf_counters];
+
+  for (size_t i = 0; i < max_threads_ * n_perf_counters; ++i)
+  {
+    fds_[i] = -1;
+  }
+
+  // every thread opens its own counters
+  thread_pool.parallel([](void* data, thread_nr_t thread_nr)
+    {
+      int* fds = reinterpret_cast<int*>(data) + thread_nr * n_perf_counters;
+
+      fds[perf_cache_misses] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+      fds[perf_dtlb_misses] = open_counter(
+        PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8U) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16U));
+      fds[perf_branch_misses] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    },
+    fds_);
+
+  for (size_t i = 0; i < max_threads_ * n_perf_counters; ++i)
+  {
+    available_ = available_ || fds_[i] >= 0;
+  }
+
+  if (!available_)
+  {
+    warn("perf_event_open failed (" << strerror(errno) << "), hardware counters are unavailable");
+  }
+
+  return available_;
+}
+
+void PerfCounters::read(uint64_t* values) const
+{
+  for (size_t i = 0; i < max_threads_ * n_perf_counters; ++i)
+  {
+    // value, time enabled, time running
+    uint64_t buf[3];
+
+    values[i] = 0;
+
+    if (fds_[i] < 0 || ::read(fds_[i], buf, sizeof(buf)) != ssize_t(sizeof(buf)))
+    {
+      continue;
+    }
+
+    // scale if the counter was multiplexed
+    values[i] = buf[2] == 0 ? 0 : uint64_t(double(buf[0]) * double(buf[1]) / double(buf[2]));
+  }
+}
+
+void PerfCounters::add(char const* name, uint64_t const* begin, uint64_t const* end)
+{
+  Phase* phase = nullptr;
+
+  for (Phase& p : phases_)
+  {
+    if (p.name == name)
+    {
+      phase = &p;
+      break;
+    }
+  }
+
+  if (phase == nullptr)
+  {
+    phases_.push_back({name, 0, std::vector<uint64_t>(max_threads_ * n_perf_counters, 0)});
+    phase = &phases_.back();
+  }
+
+  ++phase->n_calls;
+
+  for (size_t i = 0; i < max_threads_ * n_perf_counters; ++i)
+  {
+    phase->counts[i] += end[i] > begin[i] ? end[i] - begin[i] : 0;
+  }
+}
+
+void PerfCounters::report(bool per_thread) const
+{
+  if (!available_)
+  {
+    out("hardware counters are unavailable");
+    return;
+  }
+
+  for (Phase const& phase : phases_)
+  {
+    if (!per_thread)
+    {
+      out(phase.name << ": " <<
+        perf_counter_name(perf_cache_misses) << " " << phase.total(perf_cache_misses) << ", " <<
+        perf_counter_name(perf_dtlb_misses) << " " << phase.total(perf_dtlb_misses) << ", " <<
+        perf_counter_name(perf_branch_misses) << " " << phase.total(perf_branch_misses));
+      continue;
+    }
+
+    for (size_t t = 0; t < max_threads_; ++t)
+    {
+      out(phase.name << " thread " << t << ": " <<
+        perf_counter_name(perf_cache_misses) << " " << phase.count(t, perf_cache_misses) << ", " <<
+        perf_counter_name(perf_dtlb_misses) << " " << phase.count(t, perf_dtlb_misses) << ", " <<
+        perf_counter_name(perf_branch_misses) << " " << phase.count(t, perf_branch_misses));
+    }
+  }
+}
+
+/*
+ * One row per phase, thread and counter: phase,calls,thread,counter,count
+ */
+void PerfCounters::write_csv(std::ostream& os) const
+{
+  os << "phase,calls,thread,counter,count\n";
+
+  for (Phase const& phase : phases_)
+  {
+    for (size_t t = 0; t < max_threads_; ++t)
+    {
+      for (unsigned c = 0; c < n_perf_counters; ++c)
+      {
+        os << phase.name << "," << phase.n_calls << "," << t << ",";
+        os << perf_counter_name(c) << "," << phase.count(t, c) << "\n";
+      }
+    }
+  }
+}
+
+PerfScope::PerfScope(PerfCounters& counters, char const* name) :
+  counters_(counters),
+  name_(name),
+  begin_(nullptr)
+{
+  counters_.open();
+
+  begin_ = new uint64_t[counters_.n_threads() * n_perf_counters];
+  counters_.read(begin_);
+}
+
+PerfScope::~PerfScope()
+{
+  uint64_t* end = new uint64_t[counters_.n_threads() * n_perf_counters];
+
+  counters_.read(end);
+  counters_.add(name_, begin_, end);
+
+  delete[] end;
+  delete[] begin_;
+}
+
+NAMESPACE_PMT_END
+
+#endif
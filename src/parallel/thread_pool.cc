@@ -1,8 +1,20 @@
 #include "../../include/parallel/thread_pool.h"
 #include "../../include/misc/logger.h"
+#ifdef PMT_STATS
+#include <chrono>
+#endif
 
 NAMESPACE_PMT
 
+#ifdef PMT_STATS
+static double seconds_since(std::chrono::steady_clock::time_point const& start)
+{
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+  return diff.count();
+}
+#endif
+
 size_t hardware_concurrency = std::thread::hardware_concurrency();
 //size_t hardware_concurrency = 128U;
 
@@ -52,14 +64,32 @@ void ThreadPool::parallel(void (*user_f)(void *, size_t), void *user_data)
   main_flag_ = !main_flag_;
   user_data_ = user_data;
   user_f_ = user_f;
+
+#ifdef PMT_STATS
+  auto start = std::chrono::steady_clock::now();
+#endif
   
   wake_threads();    
   // mutex unlocked
 
   user_f_(user_data, 0U);
 
-  wait_ready();
-  // mutex locked
+#ifdef PMT_STATS
+  thread_data_[0].data_.busy_seconds_ += seconds_since(start);
+#endif
+
+  {
+#ifdef PMT_TRACE
+    // the main thread waits for the others to finish their blocks
+    TraceSpan span(tracer, 0U, trace_barrier);
+#endif
+    wait_ready();
+    // mutex locked
+  }
+
+#ifdef PMT_STATS
+  parallel_seconds_ += seconds_since(start);
+#endif
 
   pthread_setaffinity_np(thread_data_[0].data_.id_, sizeof(cpu_set_t), &cpu_set_);
 }  
@@ -97,6 +127,9 @@ void ThreadPool::create_threads()
   td.concurr_reads_ = 0;
   td.concurr_writes_ = 0;
 #endif
+#ifdef PMT_STATS
+  td.busy_seconds_ = 0;
+#endif
 
   // outside a parallel operation, thread 0 can use all cores.
   // in a parallel operation, thread 0 has an affinity for core 0.
@@ -111,6 +144,9 @@ void ThreadPool::create_threads()
   td.concurr_reads_ = 0;
   td.concurr_writes_ = 0;
 #endif
+#ifdef PMT_STATS
+    td.busy_seconds_ = 0;
+#endif
 
     CPU_ZERO(&cpu_set_);
     CPU_SET(i, &cpu_set_);
@@ -164,10 +200,30 @@ void* ThreadPool::thread_pool_loop(void* data)
       continue;
     }
 
+#ifdef PMT_STATS
+    auto start = std::chrono::steady_clock::now();
+#endif
+
     tp.user_f_(tp.user_data_, td.thread_nr_);
+
+#ifdef PMT_STATS
+    td.busy_seconds_ += seconds_since(start);
+#endif
   }
 }
 
+#ifdef PMT_STATS
+void ThreadPool::reset_stats()
+{
+  parallel_seconds_ = 0;
+
+  for (size_t i = 0; i < max_threads_; ++i)
+  {
+    thread_data_[i].data_.busy_seconds_ = 0;
+  }
+}
+#endif
+
 bool ThreadPool::find_work(
   ThreadData* tds,
   thread_nr_t thread_nr,
@@ -0,0 +1,72 @@
+#ifdef PMT_TRACE
+
+#include "../../include/parallel/trace.h"
+#include "../../include/misc/logger.h"
+
+NAMESPACE_PMT
+
+// the thread pool is sized from hardware_concurrency, which may be changed
+Tracer tracer(default_max_threads_limit);
+
+Tracer::Tracer(size_t max_threads) :
+  max_threads_(max_threads),
+  buffers_(new TraceBuffer*[max_threads]()),
+  start_(std::chrono::steady_clock::now())
+{
+}
+
+Tracer::~Tracer()
+{
+  for (size_t t = 0; t < max_threads_; ++t)
+  {
+    delete buffers_[t];
+  }
+
+  delete[] buffers_;
+}
+
+void Tracer::clear()
+{
+  for (size_t t = 0; t < max_threads_; ++t)
+  {
+    if (buffers_[t] != nullptr)
+    {
+      buffers_[t]->clear();
+    }
+  }
+}
+
+/*
+ * Complete events ("ph": "X") with microsecond timestamps, one track per
+ * thread
+ */
+void Tracer::write_chrome_trace(std::ostream& os) const
+{
+  bool first = true;
+
+  os << "{\"traceEvents\": [\n";
+
+  for (size_t t = 0; t < max_threads_; ++t)
+  {
+    if (buffers_[t] == nullptr) continue;
+
+    os << (first ? "" : ",\n");
+    os << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << t;
+    os << ", \"args\": {\"name\": \"thread " << t << "\"}}";
+    first = false;
+
+    buffers_[t]->apply([&](TraceEvent const& e) {
+      os << ",\n{\"name\": \"" << e.label << "\", \"cat\": \"";
+      os << (e.kind == trace_block ? "block" : "barrier") << "\", \"ph\": \"X\"";
+      os << ", \"ts\": " << double(e.begin_ns) / 1e3;
+      os << ", \"dur\": " << double(e.end_ns - e.begin_ns) / 1e3;
+      os << ", \"pid\": 0, \"tid\": " << t << "}";
+    });
+  }
+
+  os << "\n]}\n";
+}
+
+NAMESPACE_PMT_END
+
+#endif
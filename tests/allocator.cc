@@ -0,0 +1,137 @@
+#include <cstdint>
+#include <cstring>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/check_equiv.h"
+#include "../include/maxtree/tree_scan.h"
+#include "../include/misc/allocator.h"
+
+using index_t = uint32_t;
+
+void test_arena()
+{
+  size_t const page = pmt::HugePageArena::page_size;
+  pmt::HugePageArena arena(8U * page);
+
+  char* a = static_cast<char*>(arena.allocate(2U * page + 1U));
+  char* b = static_cast<char*>(arena.allocate(100U));
+
+  check(a != nullptr && b != nullptr);
+  check(uintptr_t(a) % page == 0 && uintptr_t(b) % page == 0);
+  check(arena.n_mapped() == 2U);
+
+  // pre-faulted pages are zero
+  check(a[0] == 0 && a[2U * page] == 0 && b[99] == 0);
+  memset(a, 1, 2U * page + 1U);
+
+  arena.deallocate(a, 2U * page + 1U);
+  check(arena.cached_bytes() == 3U * page);
+
+  // recycled for a request of at least half the size
+  char* c = static_cast<char*>(arena.allocate(2U * page + 100U));
+
+  check(c == a);
+  check(arena.n_recycled() == 1U);
+
+  // too small to recycle the 3 page buffer
+  arena.deallocate(c, 2U * page + 100U);
+  char* d = static_cast<char*>(arena.allocate(10U));
+
+  check(d != a && arena.n_mapped() == 3U);
+
+  arena.deallocate(b, 100U);
+  arena.deallocate(d, 10U);
+  check(arena.cached_bytes() == 5U * page);
+
+  // over the cache limit, the largest buffer is unmapped
+  char* e = static_cast<char*>(arena.allocate(5U * page));
+
+  check(arena.n_mapped() == 4U);
+  arena.deallocate(e, 5U * page);
+  check(arena.cached_bytes() == 5U * page);
+
+  arena.release();
+  check(arena.cached_bytes() == 0);
+}
+
+template <typename value_t>
+void test_maxtree(index_t width, index_t height)
+{
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+
+  size_t max_threads = pmt::thread_pool.max_threads();
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]();
+  });
+
+  delete[] rand;
+
+  index_t* parents = new index_t[n];
+  index_t* parents2 = new index_t[n];
+  index_t* parents3 = new index_t[n];
+  index_t* sizes = new index_t[n];
+
+  pmt::maxtree(img, parents);
+
+  pmt::HugePageArena arena;
+
+  pmt::set_allocator(&arena);
+  pmt::maxtree(img, parents2);
+
+  size_t n_mapped = arena.n_mapped();
+
+  // the second computation recycles the buffers of the first
+  pmt::maxtree(img, parents3);
+  check(arena.n_mapped() == n_mapped);
+  check(arena.n_recycled() > 0);
+
+  // TreeContract and IterativeSelect2Compact1 allocate from the arena too
+  auto const& weight = [](index_t i) ALWAYS_INL_L(index_t) {
+    return 1U;
+  };
+
+  auto const& plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t) {
+    return a + b;
+  };
+
+  pmt::tree_scan(parents2, n, sizes, weight, plus);
+  check(arena.n_mapped() > n_mapped);
+
+  pmt::set_allocator(nullptr);
+
+  // before check_equiv, which moves the level roots to their smallest node
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(parents2[i] != i || sizes[i] == n);
+  }
+
+  pmt::check_equiv(parents, n, parents2, vals);
+  pmt::check_equiv(parents, n, parents3, vals);
+
+  delete[] sizes;
+  delete[] parents3;
+  delete[] parents2;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main()
+{
+  test_arena();
+  test_maxtree<uint8_t>(1000, 1000);
+  test_maxtree<float>(600, 700);
+
+  info("allocator: all tests passed");
+
+  return 0;
+}
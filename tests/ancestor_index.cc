@@ -0,0 +1,124 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/ancestor_index.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+
+void construct(index_t width, index_t height, unsigned max_levels)
+{
+  index_t n = width * height;
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % 16U;
+  });
+
+  pmt::maxtree(img, parents);
+
+  pmt::AncestorIndex<index_t> index;
+
+  {
+    pmt::Timer t;
+    pmt::ancestor_index(parents, n, &index, max_levels);
+
+    printf("%f megapixel/s (%u levels)\n", n / 1e6 / t.stop(), index.n_levels());
+  }
+
+  check(index.n_levels() <= max_levels);
+
+  constexpr size_t m = 5000U;
+  std::vector<index_t> as(m), bs(m), ds(m), out_ancestors(m), out_levels(m), out_lcas(m);
+  std::vector<value_t> vs(m);
+
+  for (size_t q = 0; q < m; ++q)
+  {
+    as[q] = rand[0]() % n;
+    bs[q] = rand[0]() % n;
+    ds[q] = rand[0]() % (index.tour().depth(as[q]) + 2U);
+    vs[q] = rand[0]() % 17U;
+  }
+
+  delete[] rand;
+
+  {
+    pmt::Timer t;
+    index.ancestors(as.data(), ds.data(), m, out_ancestors.data());
+    index.ancestors_at_levels(as.data(), vals, vs.data(), m, out_levels.data());
+    index.lowest_common_ancestors(as.data(), bs.data(), m, out_lcas.data());
+
+    printf("%f million queries/s\n", 3.0 * m / 1e6 / t.stop());
+  }
+
+  std::vector<index_t> stamps(n, ~index_t(0));
+
+  for (size_t q = 0; q < m; ++q)
+  {
+    index_t x = as[q];
+    index_t d = ds[q];
+
+    while (d != 0 && parents[x] != x)
+    {
+      x = parents[x];
+      --d;
+    }
+
+    check(out_ancestors[q] == (d == 0 ? x : pmt::AncestorIndex<index_t>::none));
+
+    x = as[q];
+
+    if (vals[x] < vs[q])
+    {
+      check(out_levels[q] == pmt::AncestorIndex<index_t>::none);
+    }
+    else
+    {
+      while (parents[x] != x && vals[parents[x]] >= vs[q])
+      {
+        x = parents[x];
+      }
+
+      check(out_levels[q] == x);
+    }
+
+    for (x = as[q]; stamps[x] != q; x = parents[x])
+    {
+      stamps[x] = q;
+    }
+
+    for (x = bs[q]; stamps[x] != q; x = parents[x])
+    {
+    }
+
+    check(out_lcas[q] == x);
+  }
+
+  info("Ancestor queries seem correct.");
+
+  delete[] parents;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct(300U, 200U, 32U);
+  construct(300U, 200U, 3U);
+  construct(1U, 1U, 32U);
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <cstdint>
+#include <vector>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/reduce_edges.h"
+#include "../include/maxtree/estimate_quantiles.h"
+#include "../include/maxtree/check_equiv.h"
+
+using index_t = uint32_t;
+
+/*
+ * The histogram quantiles of values of at most 16 bits are exact: quantile
+ * i is the edge of rank i * n_edges / n_partitions, ordered by the value
+ * and index of a_.
+ */
+template <typename value_t>
+void check_quantiles(index_t width, index_t height, unsigned value_mask, size_t n_partitions)
+{
+  using prim = pmt::primitives<index_t, value_t, 2, 4>;
+  using quantile_t = pmt::Quantile<value_t, index_t>;
+
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  typename pmt::rng<index_t>::type rnd;
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    vals[i] = value_t(rnd() & value_mask);
+  }
+
+  pmt::ImageBlocks<prim> ib(img);
+  index_t* parents = new index_t[n];
+  // the local edges and the edges to the previous blocks
+  size_t max_edges = n;
+
+  for (unsigned d = 0; d < 2; ++d)
+  {
+    max_edges += n / img.dimensions()[d] * (ib.dimensions()[d] - 1U);
+  }
+
+  pmt::Graph<index_t> graph(ib.dimensions().length(), n, max_edges);
+
+  pmt::reduce_edges(ib, parents, &graph);
+
+  size_t n_edges = graph.n_edges();
+  uint64_t* aux1 = new uint64_t[n_edges];
+  uint64_t* aux2 = new uint64_t[n_edges];
+  quantile_t* quantiles = new quantile_t[n_partitions];
+
+  pmt::estimate_quantiles(graph, vals, n_partitions, quantiles, aux1, aux2);
+
+  std::vector<size_t> n_less(n_partitions, 0);
+  std::vector<size_t> n_less_or_equal(n_partitions, 0);
+
+  for (size_t s = 0; s < graph.n_subgraphs(); ++s)
+  {
+    pmt::Edge<index_t> const* edges = graph.subgraph(s);
+
+    for (size_t i = 0; i < graph.edge_count(s); ++i)
+    {
+      index_t a = edges[i].a_;
+
+      for (size_t p = 1; p < n_partitions; ++p)
+      {
+        // quantile p < (vals[a], a)
+        bool greater = a == 0 ?
+          quantiles[p].unsigned_conversion() < pmt::unsigned_conversion(vals[a]) :
+          quantiles[p].less_than_or_equal(vals[a], a - 1U);
+
+        n_less[p] += !quantiles[p].less_than_or_equal(vals[a], a);
+        n_less_or_equal[p] += !greater;
+      }
+    }
+  }
+
+  for (size_t p = 1; p < n_partitions; ++p)
+  {
+    size_t rank = p * n_edges / n_partitions;
+
+    check(n_less[p] <= rank && rank < n_less_or_equal[p]);
+  }
+
+  delete[] quantiles;
+  delete[] aux2;
+  delete[] aux1;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main()
+{
+  check_quantiles<uint8_t>(1000, 1000, 0xFFU, 4);
+  check_quantiles<uint8_t>(1000, 700, 0x3U, 8);
+  check_quantiles<uint16_t>(1000, 1000, 0xFFFFU, 16);
+  check_quantiles<int16_t>(900, 1100, 0xFFFFU, 4);
+  check_quantiles<uint16_t>(500, 500, 0x1U, 2);
+
+  info("estimate_quantiles: all tests passed");
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/euler_tour.h"
+#include "../include/maxtree/topological_order.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+
+void construct(index_t width, index_t image_height)
+{
+  index_t n = width * image_height;
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, image_height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % 64U;
+  });
+
+  delete[] rand;
+
+  pmt::maxtree(img, parents);
+
+  pmt::EulerTour<index_t> tour;
+
+  {
+    pmt::Timer t;
+    pmt::euler_tour(parents, n, &tour);
+
+    printf("%f megapixel/s (Euler tour)\n", n / 1e6 / t.stop());
+  }
+
+  index_t* depths = new index_t[n];
+  index_t* heights = new index_t[n];
+
+  {
+    pmt::Timer t;
+    pmt::topological_height(parents, n, depths, heights);
+
+    printf("%f megapixel/s (topological height)\n", n / 1e6 / t.stop());
+  }
+
+  // sequential depth-first search, children in index order
+  std::vector<std::vector<index_t>> childs(n);
+  index_t root = 0;
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (parents[i] == i)
+    {
+      root = i;
+      continue;
+    }
+
+    childs[parents[i]].push_back(i);
+  }
+
+  std::vector<index_t> entries(n), exits(n), depth(n), height(n, 0), preorder;
+  std::vector<std::pair<index_t, bool>> stack{{root, false}};
+
+  depth[root] = 0;
+
+  while (!stack.empty())
+  {
+    auto top = stack.back();
+    stack.pop_back();
+
+    index_t x = top.first;
+
+    if (top.second)
+    {
+      exits[x] = preorder.size();
+
+      for (index_t c : childs[x])
+      {
+        height[x] = std::max(height[x], height[c] + 1U);
+      }
+
+      continue;
+    }
+
+    entries[x] = preorder.size();
+    preorder.push_back(x);
+    stack.push_back({x, true});
+
+    for (size_t k = childs[x].size(); k--;)
+    {
+      index_t c = childs[x][k];
+      depth[c] = depth[x] + 1U;
+      stack.push_back({c, false});
+    }
+  }
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(tour.entry(i) == entries[i]);
+    check(tour.exit(i) == exits[i]);
+    check(tour.node(i) == preorder[i]);
+    check(tour.depth(i) == depth[i]);
+    check(depths[i] == depth[i]);
+    check(heights[i] == height[i]);
+    check(tour.is_ancestor(parents[i], i));
+  }
+
+  for (index_t i = 0; i < n; i += 97U)
+  {
+    for (index_t k : {0U, 1U, 2U, 5U})
+    {
+      size_t count = 0;
+
+      for (index_t p = entries[i]; p != exits[i]; ++p)
+      {
+        count += depth[preorder[p]] == depth[i] + k;
+      }
+
+      check(tour.count_descendants_at_depth(i, k) == count);
+    }
+  }
+
+  info("Euler tour and topological heights seem correct.");
+
+  delete[] heights;
+  delete[] depths;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct(1U, 1U);
+  construct(300U, 200U);
+  construct(1000U, 1000U);
+
+  return 0;
+}
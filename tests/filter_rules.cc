@@ -0,0 +1,231 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/tree_scan.h"
+#include "../include/maxtree/tree_scan_seq.h"
+#include "../include/maxtree/rootfix_seq.h"
+#include "../include/maxtree/reconstruct_image.h"
+#include "../include/maxtree/reconstruct_image_seq.h"
+
+using index_t = uint32_t;
+using attribute_t = uint32_t;
+using value_t = uint8_t;
+
+// value of the first ancestor (or the node itself) that is kept
+void reconstruct_seq(value_t const* values, index_t n, value_t* values_out, index_t* parents, uint8_t const* kept)
+{
+  pmt::reconstruct_image_seq(values, n, values_out, parents, [=](index_t i) ALWAYS_INL_L(bool) {
+    return kept[i];
+  });
+}
+
+void check_equal(value_t const* a, value_t const* b, index_t n, char const* rule)
+{
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(a[i] == b[i]);
+  }
+
+  info(rule << " rule seems correct.");
+}
+
+void construct(index_t width, index_t height)
+{
+  index_t n = width * height;
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  value_t* vals_out = new value_t[n];
+  value_t* vals_out2 = new value_t[n];
+  attribute_t* areas = new attribute_t[n];
+  index_t* parents = new index_t[n];
+  uint8_t* kept = new uint8_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % 32U;
+  });
+
+  delete[] rand;
+
+  auto const &w = [](index_t i) ALWAYS_INL_L(attribute_t)
+  {
+    return 1U;
+  };
+
+  auto const &plus = [](attribute_t a, attribute_t b) ALWAYS_INL_L(attribute_t)
+  {
+    return a + b;
+  };
+
+  pmt::maxtree(img, parents);
+  pmt::tree_scan(parents, n, areas, w, plus);
+
+  // not increasing
+  auto const &criterion = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return ((i * 2654435761U) >> 29U) != 0 && areas[i] > 4U;
+  };
+
+  auto const &is_root = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return parents[i] == i;
+  };
+
+  auto const &w_kept = [=](index_t i) ALWAYS_INL_L(uint8_t)
+  {
+    return is_root(i) || criterion(i);
+  };
+
+  auto const &f_or = [](uint8_t a, uint8_t b) ALWAYS_INL_L(uint8_t)
+  {
+    return a | b;
+  };
+
+  auto const &f_and = [](uint8_t a, uint8_t b) ALWAYS_INL_L(uint8_t)
+  {
+    return a & b;
+  };
+
+  {
+    pmt::reconstruct_image_max(vals, n, vals_out, parents, criterion);
+
+    pmt::tree_scan_seq(parents, n, kept, w_kept, f_or);
+    reconstruct_seq(vals, n, vals_out2, parents, kept);
+    check_equal(vals_out, vals_out2, n, "Max");
+  }
+
+  {
+    pmt::reconstruct_image_min(vals, n, vals_out, parents, criterion);
+
+    pmt::rootfix_seq(parents, n, kept, w_kept, f_and);
+    reconstruct_seq(vals, n, vals_out2, parents, kept);
+    check_equal(vals_out, vals_out2, n, "Min");
+  }
+
+  {
+    pmt::reconstruct_image_subtractive(vals, n, vals_out, parents, criterion);
+
+    int* lowered = new int[n];
+    value_t* lowered_vals = new value_t[n];
+
+    auto const &w_diff = [=](index_t i) ALWAYS_INL_L(int)
+    {
+      return w_kept(i) ? 0 : vals[i] - vals[parents[i]];
+    };
+
+    auto const &f_plus = [](int a, int b) ALWAYS_INL_L(int)
+    {
+      return a + b;
+    };
+
+    pmt::rootfix_seq(parents, n, lowered, w_diff, f_plus);
+
+    for (index_t i = 0; i < n; ++i)
+    {
+      check(lowered[i] <= vals[i]);
+      lowered_vals[i] = vals[i] - lowered[i];
+      kept[i] = w_kept(i);
+    }
+
+    reconstruct_seq(lowered_vals, n, vals_out2, parents, kept);
+
+    delete[] lowered_vals;
+    delete[] lowered;
+
+    check_equal(vals_out, vals_out2, n, "Subtractive");
+  }
+
+  {
+    auto const &cost_keep = [=](index_t i) ALWAYS_INL_L(int64_t)
+    {
+      return (i * 2654435761U) >> 30U;
+    };
+
+    auto const &cost_remove = [=](index_t i) ALWAYS_INL_L(int64_t)
+    {
+      return vals[i] % 3U;
+    };
+
+    pmt::reconstruct_image_viterbi(vals, n, vals_out, parents, cost_keep, cost_remove);
+
+    // minimal costs, with explicit child lists in post-order
+    std::vector<std::vector<index_t>> childs(n);
+    index_t root = 0;
+
+    for (index_t i = 0; i < n; ++i)
+    {
+      if (is_root(i))
+      {
+        root = i;
+        continue;
+      }
+
+      childs[parents[i]].push_back(i);
+    }
+
+    std::vector<int64_t> best(n);
+    std::vector<int64_t> remove(n);
+    std::vector<std::pair<index_t, bool>> stack{{root, false}};
+
+    while (!stack.empty())
+    {
+      auto top = stack.back();
+      stack.pop_back();
+
+      index_t x = top.first;
+
+      if (!top.second)
+      {
+        stack.push_back({x, true});
+
+        for (index_t c : childs[x])
+        {
+          stack.push_back({c, false});
+        }
+
+        continue;
+      }
+
+      int64_t keep_cost = cost_keep(x);
+      remove[x] = cost_remove(x);
+
+      for (index_t c : childs[x])
+      {
+        keep_cost += best[c];
+        remove[x] += remove[c];
+      }
+
+      kept[x] = x == root || remove[x] >= keep_cost;
+      best[x] = kept[x] ? keep_cost : remove[x];
+    }
+
+    pmt::rootfix_seq(parents, n, kept, [=](index_t i) ALWAYS_INL_L(uint8_t) { return kept[i]; }, f_and);
+    reconstruct_seq(vals, n, vals_out2, parents, kept);
+    check_equal(vals_out, vals_out2, n, "Viterbi");
+  }
+
+  delete[] kept;
+  delete[] parents;
+  delete[] areas;
+  delete[] vals_out2;
+  delete[] vals_out;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct(256U, 256U);
+  construct(1000U, 700U);
+
+  return 0;
+}
@@ -0,0 +1,184 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/label_components.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+
+/*
+ * Breadth-first labelling, with the root of every component being its
+ * minimal (value, index) pixel
+ */
+template <typename prim, typename functor_t>
+void label_components_seq(pmt::Image<prim> const& img, functor_t const& connected, index_t* labels)
+{
+  using coordinate_t = pmt::Coordinate<prim>;
+
+  auto const& dims = img.dimensions();
+  value_t const* vals = img.values();
+  index_t n = dims.length();
+  constexpr index_t none = ~index_t(0);
+  std::vector<index_t> queue;
+
+  std::fill(labels, labels + n, none);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (labels[i] != none) continue;
+
+    queue.clear();
+    queue.push_back(i);
+    labels[i] = i;
+
+    index_t root = i;
+
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+      index_t x = queue[q];
+      coordinate_t c = coordinate_t::from_index(x, dims);
+
+      if (vals[x] < vals[root]) root = x;
+
+      for (int dy = -1; dy <= 1; ++dy)
+      {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+          for (int dz = -1; dz <= 1; ++dz)
+          {
+            int delta[3] = {dx, dy, dz};
+            int n_steps = 0;
+            bool inside = true;
+            coordinate_t nc = c;
+
+            for (size_t d = 0; d < 3; ++d)
+            {
+              if (delta[d] == 0) continue;
+              if (d >= prim::n_dimensions) inside = false;
+              if (!inside) break;
+
+              ++n_steps;
+              nc[d] += delta[d];
+              inside = nc[d] < dims[d];
+            }
+
+            if (!inside || n_steps == 0) continue;
+            if (n_steps > 1 && !(prim::n_neighbors == 8 && n_steps == 2)) continue;
+
+            index_t y = nc.index(dims);
+
+            if (labels[y] == none && connected(vals[x], vals[y]))
+            {
+              labels[y] = i;
+              queue.push_back(y);
+            }
+          }
+        }
+      }
+    }
+
+    // i is the smallest index, so the first pixel with the minimal value
+    for (index_t x : queue)
+    {
+      if (vals[x] == vals[root] && x < root) root = x;
+    }
+
+    for (index_t x : queue)
+    {
+      labels[x] = root;
+    }
+  }
+}
+
+template <size_t n_dimensions, size_t n_neighbors, typename functor_t>
+void test(pmt::Dimensions<n_dimensions> const& dims, unsigned n_levels, functor_t const& connected)
+{
+  using prim = pmt::primitives<index_t, value_t, n_dimensions, n_neighbors>;
+
+  index_t n = dims.length();
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  index_t* labels = new index_t[n];
+  index_t* expected = new index_t[n];
+
+  pmt::Image<prim> img(vals, dims);
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % n_levels;
+  });
+
+  delete[] rand;
+
+  {
+    pmt::Timer t;
+    pmt::label_components(img, connected, labels);
+    info("label_components " << n_dimensions << "D " << n_neighbors << "n: " << t.stop() << " s");
+  }
+
+  label_components_seq(img, connected, expected);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(labels[i] == expected[i]);
+  }
+
+  delete[] expected;
+  delete[] labels;
+  delete[] vals;
+}
+
+template <size_t n_dimensions, size_t n_neighbors>
+void test_flat_zones(pmt::Dimensions<n_dimensions> const& dims)
+{
+  using prim = pmt::primitives<index_t, value_t, n_dimensions, n_neighbors>;
+
+  index_t n = dims.length();
+  value_t* vals = new value_t[n];
+  index_t* labels = new index_t[n];
+
+  // stripes of width 3 along the first dimension
+  for (index_t i = 0; i < n; ++i)
+  {
+    vals[i] = (i % dims[0]) / 3U % 2U;
+  }
+
+  pmt::Image<prim> img(vals, dims);
+
+  pmt::label_flat_zones(img, labels);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(labels[i] == (i % dims[0]) / 3U * 3U);
+  }
+
+  delete[] labels;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  auto const& equal = [](value_t a, value_t b) { return a == b; };
+  auto const& foreground = [](value_t a, value_t b) { return a != 0 && b != 0; };
+
+  test<2, 4>(pmt::Dimensions<2>({700, 530}), 3U, equal);
+  test<2, 4>(pmt::Dimensions<2>({700, 530}), 3U, foreground);
+  test<2, 8>(pmt::Dimensions<2>({600, 520}), 4U, equal);
+  test<2, 8>(pmt::Dimensions<2>({600, 520}), 3U, foreground);
+  test<3, 6>(pmt::Dimensions<3>({150, 70, 45}), 3U, equal);
+  test<3, 6>(pmt::Dimensions<3>({150, 70, 45}), 2U, foreground);
+
+  test_flat_zones<2, 4>(pmt::Dimensions<2>({1000, 300}));
+  test_flat_zones<2, 8>(pmt::Dimensions<2>({1000, 300}));
+  test_flat_zones<3, 6>(pmt::Dimensions<3>({200, 40, 40}));
+
+  info("label_components: all tests passed");
+
+  return 0;
+}
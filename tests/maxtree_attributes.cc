@@ -0,0 +1,84 @@
+#include <cstdint>
+#include <iostream>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/tree_scan.h"
+
+using index_t = uint32_t;
+
+template <typename value_t, size_t n_neighbors>
+void construct(index_t W, index_t H, size_t n_partitions)
+{
+  index_t N = W * H;
+
+  value_t* vals = new value_t[N];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, n_neighbors>::type;
+  image_t img(vals, {W, H});
+  check(img.dimensions().length() == N);
+
+  using rng = typename pmt::rng<index_t>::type;
+
+  rng* rand = new rng[pmt::thread_pool.max_threads()];
+
+  pmt::thread_pool.for_all(N, [=](index_t i, pmt::thread_nr_t t) {
+    // few levels, so there are large plateaus crossing block boundaries
+    vals[i] = rand[t]() % 16U;
+  });
+
+  // more partitions than threads is allowed
+  size_t hardware_concurrency = pmt::hardware_concurrency;
+  pmt::hardware_concurrency = n_partitions;
+
+  index_t* parents = new index_t[N];
+  uint64_t* sums = new uint64_t[N];
+
+  auto const &weight = [=](index_t i) ALWAYS_INL_L(uint64_t) {
+    return (uint64_t(i) << 32U) | 1U;
+  };
+
+  auto const &plus = [](uint64_t a, uint64_t b) ALWAYS_INL_L(uint64_t) {
+    return a + b;
+  };
+
+  {
+    pmt::Timer t;
+    pmt::maxtree(img, parents, sums, weight, plus);
+
+    printf("%f megapixel/s (max-tree with attributes)\n", N / 1e6 / t.stop());
+  }
+
+  pmt::hardware_concurrency = hardware_concurrency;
+
+  uint64_t* sums2 = new uint64_t[N];
+
+  pmt::tree_scan(parents, N, sums2, weight, plus);
+
+  for (size_t i = 0; i < N; ++i)
+  {
+    check(sums[i] == sums2[i]);
+  }
+
+  info("Attributes match for " << W << "x" << H << ", " << n_partitions << " partitions.");
+
+  delete[] sums2;
+  delete[] sums;
+  delete[] parents;
+  delete[] rand;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct<uint8_t, 4>(1, 1, 1);
+  construct<uint8_t, 4>(100, 100, 1);
+  construct<uint8_t, 4>(1000, 1000, 1);
+  construct<uint8_t, 4>(1000, 1000, 8);
+  construct<uint8_t, 8>(1000, 1000, 8);
+  construct<uint16_t, 4>(1024, 1024, 4);
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <cstdint>
+#include <iostream>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/maxtree_stats.h"
+#include "../include/maxtree/check_equiv.h"
+
+using index_t = uint32_t;
+
+template <typename value_t>
+void construct(index_t width, index_t height)
+{
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+
+  size_t max_threads = pmt::thread_pool.max_threads();
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]();
+  });
+
+  delete[] rand;
+
+  index_t* parents = new index_t[n];
+  index_t* parents2 = new index_t[n];
+
+  pmt::MaxtreeStats stats;
+
+  pmt::maxtree(img, parents, &stats);
+  pmt::maxtree(img, parents2);
+  pmt::check_equiv(parents, n, parents2, vals);
+
+  check(stats.n_nodes == n);
+  check(stats.n_reduced_edges > 0);
+  check(stats.n_sort_digits == sizeof(value_t));
+
+  double phases = 0;
+
+  for (unsigned k = 0; k < pmt::n_maxtree_phases; ++k)
+  {
+    check(stats.phase_seconds[k] >= 0);
+    phases += stats.phase_seconds[k];
+  }
+
+  check(phases <= stats.total_seconds);
+  check(stats.phase_seconds[pmt::phase_scan_attributes] == 0);
+
+  size_t n_partitions = stats.partition_edge_counts.size();
+  size_t n_partition_edges = 0;
+
+  check(n_partitions >= 1);
+  check((n_partitions & (n_partitions - 1U)) == 0);
+  check(stats.n_partition_rounds == pmt::log2(n_partitions));
+
+  for (size_t count : stats.partition_edge_counts)
+  {
+    n_partition_edges += count;
+  }
+
+  // partitioning contracts edges within partitions and splits the others
+  check(n_partition_edges > 0);
+
+#ifdef PMT_STATS
+  check(stats.thread_busy_seconds.size() == max_threads);
+  // a single thread never enters a parallel section
+  check(max_threads == 1 || stats.thread_busy_seconds[0] > 0);
+#else
+  check(stats.thread_busy_seconds.empty());
+#endif
+
+  stats.write_json(std::cout);
+
+  delete[] parents2;
+  delete[] parents;
+  delete[] vals;
+}
+
+void construct_single_pixel()
+{
+  uint8_t val = 3;
+  index_t parent = 1;
+
+  using image_t = typename pmt::image<index_t, uint8_t, 2, 4>::type;
+  image_t img(&val, {1U, 1U});
+
+  pmt::MaxtreeStats stats;
+  pmt::maxtree(img, &parent, &stats);
+
+  check(parent == 0);
+  check(stats.n_nodes == 1);
+  check(stats.n_reduced_edges == 0);
+  check(stats.partition_edge_counts.empty());
+}
+
+int main(int argc, char** argv)
+{
+  construct<uint8_t>(1000, 700);
+  construct<uint16_t>(1500, 1100);
+  construct_single_pixel();
+
+  info("maxtree_stats: all tests passed");
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <iostream>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/maxtree_stats.h"
+#include "../include/maxtree/check_equiv.h"
+#include "../include/misc/memory_tracker.h"
+
+using index_t = uint32_t;
+
+template <typename value_t>
+void construct(index_t width, index_t height)
+{
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+
+  size_t max_threads = pmt::thread_pool.max_threads();
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]();
+  });
+
+  delete[] rand;
+
+  index_t* parents = new index_t[n];
+  index_t* parents2 = new index_t[n];
+  size_t in_use = pmt::memory_tracker.current();
+
+  pmt::MaxtreeStats stats;
+  pmt::MaxtreeStats budget_stats;
+
+  pmt::maxtree(img, parents, &stats);
+
+  // all tracked buffers are released
+  check(pmt::memory_tracker.current() == in_use);
+  check(!stats.low_memory);
+  // the rank sets of union by rank
+  check(stats.peak_bytes >= in_use + n * sizeof(pmt::RankSet<index_t>));
+  check(stats.phase_peak_bytes[pmt::phase_union_by_rank] <= stats.peak_bytes);
+  check(stats.phase_peak_bytes[pmt::phase_reduce_edges] > in_use);
+
+  // well below the default peak, a single partition fits
+  pmt::memory_tracker.set_budget(stats.peak_bytes * 3U / 4U);
+  pmt::maxtree(img, parents2, &budget_stats);
+
+  pmt::check_equiv(parents, n, parents2, vals);
+  check(pmt::memory_tracker.current() == in_use);
+  check(budget_stats.low_memory && !budget_stats.in_place_sort);
+  check(budget_stats.partition_edge_counts.size() == 1U);
+  check(budget_stats.peak_bytes < stats.peak_bytes);
+
+  // a budget that is always exceeded selects the in-place sort as well
+  pmt::MaxtreeStats in_place_stats;
+
+  pmt::memory_tracker.set_budget(1);
+  pmt::maxtree(img, parents2, &in_place_stats);
+  pmt::memory_tracker.set_budget(0);
+
+  pmt::check_equiv(parents, n, parents2, vals);
+  check(pmt::memory_tracker.current() == in_use);
+  check(in_place_stats.low_memory && in_place_stats.in_place_sort);
+  // at least the top digit and the conversion to edges
+  check(in_place_stats.n_sort_digits >= 2U);
+  check(in_place_stats.n_sort_digits <= budget_stats.n_sort_digits + 1U);
+  check(in_place_stats.peak_bytes <= budget_stats.peak_bytes);
+  // the in-place sort halves the peak of the sort phase
+  check(2U * in_place_stats.phase_peak_bytes[pmt::phase_sort_exported_edges] <=
+    budget_stats.phase_peak_bytes[pmt::phase_sort_exported_edges]);
+
+  info("peak " << stats.peak_bytes << " bytes, single partition " << budget_stats.peak_bytes <<
+    " bytes, in-place sort " << in_place_stats.peak_bytes << " bytes, sort phase " <<
+    budget_stats.phase_peak_bytes[pmt::phase_sort_exported_edges] << " -> " <<
+    in_place_stats.phase_peak_bytes[pmt::phase_sort_exported_edges] << " bytes");
+
+  delete[] parents2;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main()
+{
+  // partitions are only used with more than one thread
+  pmt::hardware_concurrency = 4;
+
+  construct<uint8_t>(1000, 1000);
+  construct<uint16_t>(1000, 1000);
+  construct<float>(512, 2000);
+
+  return 0;
+}
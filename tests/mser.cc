@@ -0,0 +1,199 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/tree_scan_seq.h"
+#include "../include/maxtree/mser.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+
+void construct(index_t width, index_t height, pmt::MserParams const& params)
+{
+  index_t n = width * height;
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  // blobs with a little noise
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    index_t x = i % width;
+    index_t y = i / width;
+    index_t blob = ((x / 40U) * 7U + (y / 40U) * 13U) % 5U;
+    index_t dx = x % 40U < 20U ? x % 40U : 40U - x % 40U;
+    index_t dy = y % 40U < 20U ? y % 40U : 40U - y % 40U;
+    vals[i] = blob * 20U + std::min(dx, dy) * 4U + rand[t]() % 3U;
+  });
+
+  delete[] rand;
+
+  pmt::maxtree(img, parents);
+
+  pmt::Msers<index_t> regions;
+
+  {
+    pmt::Timer t;
+    pmt::msers(parents, n, vals, params, &regions);
+
+    printf("%f megapixel/s (%zu regions)\n", n / 1e6 / t.stop(), regions.n_regions());
+  }
+
+  check(regions.n_regions() > 0);
+
+  // sequential reference, with explicit level roots
+  index_t* areas = new index_t[n];
+
+  pmt::tree_scan_seq(parents, n, areas, [](index_t i) ALWAYS_INL_L(index_t) { return 1U; },
+    [](index_t a, index_t b) ALWAYS_INL_L(index_t) { return a + b; });
+
+  std::vector<index_t> level_root(n);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    index_t x = i;
+
+    while (parents[x] != x && vals[parents[x]] == vals[i])
+    {
+      x = parents[x];
+    }
+
+    level_root[i] = x;
+  }
+
+  auto const& is_region = [&](index_t i)
+  {
+    return level_root[i] == i && parents[i] != i;
+  };
+
+  std::vector<float> variation(n);
+  std::vector<uint8_t> stable(n, 0);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (!is_region(i)) continue;
+
+    index_t a = i;
+
+    while (parents[a] != a && vals[i] - vals[level_root[parents[a]]] <= params.delta)
+    {
+      a = level_root[parents[a]];
+    }
+
+    variation[i] = float(areas[a] - areas[i]) / float(areas[i]);
+    stable[i] = 1;
+  }
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (!is_region(i)) continue;
+
+    index_t parent = level_root[parents[i]];
+
+    if (!is_region(parent)) continue;
+
+    if (variation[i] > variation[parent]) stable[i] = 0;
+    if (variation[i] <= variation[parent]) stable[parent] = 0;
+  }
+
+  std::vector<index_t> region_of(n, ~index_t(0));
+  size_t m = 0;
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (stable[i] && areas[i] >= params.min_area && areas[i] <= params.max_area &&
+      variation[i] <= float(params.max_variation))
+    {
+      check(regions.node(m) == i);
+      region_of[i] = m++;
+    }
+  }
+
+  check(regions.n_regions() == m);
+
+  // memoized walk to the nearest region
+  std::vector<index_t> memo(n, ~index_t(0) - 1U);
+  std::vector<index_t> path;
+
+  auto const& innermost = [&](index_t x)
+  {
+    while (memo[x] == ~index_t(0) - 1U)
+    {
+      path.push_back(x);
+
+      if (region_of[x] != ~index_t(0) || parents[x] == x)
+      {
+        memo[x] = region_of[x];
+        break;
+      }
+
+      x = parents[x];
+    }
+
+    index_t r = memo[x];
+
+    for (index_t y : path)
+    {
+      memo[y] = r;
+    }
+
+    path.clear();
+
+    return r;
+  };
+
+  size_t n_labelled = 0;
+
+  for (size_t r = 0; r < m; ++r)
+  {
+    index_t node = regions.node(r);
+    index_t parent = parents[node] == node ? ~index_t(0) : innermost(parents[node]);
+
+    check(regions.parent(r) == parent);
+
+    for (index_t const* p = regions.pixels_begin(r); p != regions.pixels_end(r); ++p)
+    {
+      check(innermost(*p) == r);
+      ++n_labelled;
+    }
+  }
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    n_labelled -= innermost(i) != ~index_t(0);
+  }
+
+  check(n_labelled == 0);
+
+  info("MSERs seem correct.");
+
+  delete[] areas;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  pmt::MserParams params;
+
+  construct(400U, 300U, params);
+
+  params.delta = 2.0;
+  params.min_area = 10U;
+  params.max_area = 5000U;
+  params.max_variation = 1.0;
+
+  construct(1000U, 700U, params);
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include <cstdint>
+#include <vector>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/maxtree_stats.h"
+#include "../include/maxtree/check_equiv.h"
+#include "../include/sort/multiway_merge.h"
+#include "../include/sort/sort_item.h"
+#include "../include/misc/random.h"
+
+using index_t = uint32_t;
+using pair_t = pmt::SortPair<uint16_t, index_t>;
+
+void check_merge(size_t k, size_t max_length, uint16_t max_value)
+{
+  typename pmt::rng<index_t>::type rnd;
+  std::vector<std::vector<pair_t>> runs(k);
+  std::vector<pair_t const*> begins(k);
+  std::vector<pair_t const*> ends(k);
+  std::vector<size_t> splits(k);
+  size_t n = 0;
+
+  for (size_t r = 0; r < k; ++r)
+  {
+    size_t length = rnd() % (max_length + 1U);
+
+    for (size_t i = 0; i < length; ++i)
+    {
+      runs[r].push_back({uint16_t(rnd() % (max_value + 1U)), index_t(n++)});
+    }
+
+    std::sort(runs[r].begin(), runs[r].end(), [](pair_t const& a, pair_t const& b) {
+      return a.unsigned_value() < b.unsigned_value();
+    });
+
+    begins[r] = runs[r].data();
+    ends[r] = runs[r].data() + runs[r].size();
+  }
+
+  std::vector<index_t> merged(n);
+  std::vector<uint16_t> keys(n);
+  std::vector<uint8_t> seen(n, 0);
+
+  for (size_t r = 0; r < k; ++r)
+  {
+    for (pair_t const& item : runs[r])
+    {
+      keys[item.data()] = item.unsigned_value();
+    }
+  }
+
+  pmt::multiway_merge(begins.data(), ends.data(), k, merged.data(),
+    [](index_t& o, pair_t const& item) { o = item.data(); });
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    check(!seen[merged[i]]);
+    check(i == 0 || keys[merged[i - 1]] <= keys[merged[i]]);
+
+    seen[merged[i]] = 1;
+  }
+
+  // the split at rank r has the r smallest items in front
+  for (size_t rank : {size_t(0), n / 3U, n / 2U, n})
+  {
+    if (k == 0) break;
+
+    pmt::multiway_split(begins.data(), ends.data(), k, rank, splits.data());
+
+    size_t total = 0;
+
+    for (size_t r = 0; r < k; ++r)
+    {
+      check(splits[r] <= runs[r].size());
+      total += splits[r];
+
+      for (size_t i = 0; i < splits[r]; ++i)
+      {
+        check(rank > 0 && runs[r][i].unsigned_value() <= keys[merged[rank - 1U]]);
+      }
+
+      for (size_t i = splits[r]; i < runs[r].size(); ++i)
+      {
+        check(rank < n && runs[r][i].unsigned_value() >= keys[merged[rank]]);
+      }
+    }
+
+    check(total == rank);
+  }
+}
+
+template <typename value_t>
+void check_maxtree(index_t width, index_t height, size_t n_partitions)
+{
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+
+  size_t max_threads = pmt::thread_pool.max_threads();
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]();
+  });
+
+  delete[] rand;
+
+  index_t* parents = new index_t[n];
+  index_t* parents2 = new index_t[n];
+  pmt::MaxtreeStats stats;
+
+  pmt::hardware_concurrency = n_partitions;
+  pmt::maxtree(img, parents);
+
+  pmt::edge_sort = pmt::edge_sort_merge;
+  pmt::maxtree(img, parents2, &stats);
+  pmt::edge_sort = pmt::edge_sort_radix;
+
+  pmt::check_equiv(parents, n, parents2, vals);
+  check(stats.n_sorted_runs > 0);
+  // the digits of the runs and the merge
+  check(stats.n_sort_digits == pmt::radix_sort_n_digits<decltype(pmt::unsigned_conversion(value_t(0)))>() + 1U);
+  check(stats.partition_edge_counts.size() == n_partitions);
+
+  delete[] parents2;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main()
+{
+  check_merge(0, 0, 0);
+  check_merge(1, 1000, 65535);
+  check_merge(3, 0, 10);
+  check_merge(5, 1000, 3);
+  check_merge(100, 500, 65535);
+  check_merge(129, 2000, 1000);
+
+  // partitions are only used with more than one thread
+  check_maxtree<uint8_t>(1000, 1000, 4);
+  check_maxtree<uint16_t>(1000, 1000, 4);
+  check_maxtree<uint32_t>(700, 900, 1);
+  check_maxtree<float>(512, 2000, 4);
+
+  info("multiway_merge: all tests passed");
+
+  return 0;
+}
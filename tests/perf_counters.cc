@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/parallel/perf_counters.h"
+
+using index_t = uint32_t;
+using value_t = uint16_t;
+
+int main(int argc, char** argv)
+{
+#ifndef PMT_PERF_COUNTERS
+  info("PMT_PERF_COUNTERS is not defined, nothing to test");
+#else
+  index_t width = 1500;
+  index_t height = 1000;
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[pmt::thread_pool.max_threads()];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]();
+  });
+
+  delete[] rand;
+
+  {
+    pmt::Timer t("maxtree");
+    pmt::PerfScope scope(pmt::perf_counters, "maxtree");
+    pmt::maxtree(img, parents);
+  }
+
+  pmt::perf_counters.report();
+
+  auto const& phases = pmt::perf_counters.phases();
+
+  auto const& find = [&](std::string const& name) -> pmt::PerfCounters::Phase const*
+  {
+    for (auto const& phase : phases)
+    {
+      if (phase.name == name) return &phase;
+    }
+
+    return nullptr;
+  };
+
+  // recorded even if the counters are unavailable
+  check(find("maxtree") != nullptr);
+  check(find("reduce_edges") != nullptr);
+  check(find("union_by_rank") != nullptr);
+  check(find("RadixSortParallel") != nullptr);
+  check(find("maxtree")->n_calls == 1);
+  check(find("maxtree")->counts.size() == pmt::thread_pool.max_threads() * pmt::n_perf_counters);
+
+  if (pmt::perf_counters.available())
+  {
+    // inclusive counts
+    check(find("maxtree")->total(pmt::perf_branch_misses) >= find("reduce_edges")->total(pmt::perf_branch_misses));
+  }
+  else
+  {
+    check(find("maxtree")->total(pmt::perf_cache_misses) == 0);
+  }
+
+  std::stringstream ss;
+  pmt::perf_counters.write_csv(ss);
+  check(ss.str().find("maxtree,1,0,branch-misses,") != std::string::npos);
+
+  delete[] parents;
+  delete[] vals;
+#endif
+
+  info("perf_counters: all tests passed");
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <iostream>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/tree_scan.h"
+#include "../include/maxtree/reconstruct_image.h"
+#include "../include/maxtree/prune_tree.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+using attribute_t = uint32_t;
+
+void construct(index_t width, index_t height)
+{
+  index_t n = width * height;
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  value_t* vals_out = new value_t[n];
+  index_t* parents = new index_t[n];
+  attribute_t* areas = new attribute_t[n];
+  index_t* new_parents = new index_t[n];
+  index_t* old_to_new = new index_t[n];
+  index_t* new_to_old = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % 64U;
+  });
+
+  delete[] rand;
+
+  auto const& plus = [](attribute_t a, attribute_t b) ALWAYS_INL_L(attribute_t)
+  {
+    return a + b;
+  };
+
+  pmt::maxtree(img, parents);
+  pmt::tree_scan(parents, n, areas, [](index_t i) ALWAYS_INL_L(attribute_t) { return 1U; }, plus);
+
+  auto const& criterion = [=](index_t i) ALWAYS_INL_L(bool)
+  {
+    return areas[i] >= 25U;
+  };
+
+  size_t m;
+
+  {
+    pmt::Timer t;
+    m = pmt::prune_tree(parents, n, criterion, new_parents, old_to_new, new_to_old);
+
+    printf("%f megapixel/s (%zu of %u nodes kept)\n", n / 1e6 / t.stop(), m, n);
+  }
+
+  check(m > 0 && m < n);
+
+  value_t* new_vals = new value_t[m];
+  attribute_t* new_areas = new attribute_t[m];
+  attribute_t* pixel_counts = new attribute_t[m];
+
+  pmt::remap_attributes(new_to_old, m, vals, new_vals);
+  pmt::remap_attributes(new_to_old, m, areas, new_areas);
+
+  // the pruned tree is a tree of the kept nodes, in index order
+  for (index_t j = 0; j < m; ++j)
+  {
+    index_t old = new_to_old[j];
+
+    check(j == 0 || new_to_old[j - 1U] < old);
+    check(old_to_new[old] == j);
+    check(parents[old] == old || criterion(old));
+    check(new_parents[j] < m);
+    check(new_parents[j] != j || parents[old] == old);
+  }
+
+  // the direct rule maps every pixel to the value of its surviving node
+  pmt::reconstruct_image(vals, n, vals_out, parents, [=](index_t i) ALWAYS_INL_L(bool) {
+    return parents[i] == i || criterion(i);
+  });
+
+  std::fill(pixel_counts, pixel_counts + m, 0U);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(vals_out[i] == new_vals[old_to_new[i]]);
+    ++pixel_counts[old_to_new[i]];
+  }
+
+  // scans on the pruned tree give the areas of the original tree
+  attribute_t* scanned = new attribute_t[m];
+
+  pmt::tree_scan(new_parents, m, scanned, [=](index_t j) ALWAYS_INL_L(attribute_t) { return pixel_counts[j]; }, plus);
+
+  for (index_t j = 0; j < m; ++j)
+  {
+    check(scanned[j] == new_areas[j]);
+  }
+
+  info("Pruned tree seems correct.");
+
+  delete[] scanned;
+  delete[] pixel_counts;
+  delete[] new_areas;
+  delete[] new_vals;
+  delete[] new_to_old;
+  delete[] old_to_new;
+  delete[] new_parents;
+  delete[] areas;
+  delete[] parents;
+  delete[] vals_out;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct(300U, 200U);
+  construct(1000U, 1000U);
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "../include/sort/radix_sort_in_place.h"
+#include "../include/sort/sort_item.h"
+#include "../include/misc/timer.h"
+#include "../include/misc/random.h"
+#include "../include/misc/unsigned_conversion.h"
+
+using index_t = uint32_t;
+
+enum distribution_t
+{
+  uniform,
+  few_values,
+  descending
+};
+
+template <typename value_t>
+void check_sort(char const* s, size_t n, distribution_t distribution, size_t n_stripes)
+{
+  using uvalue_t = decltype(pmt::unsigned_conversion(value_t(0)));
+  using SortPair = pmt::SortPair<uvalue_t, index_t>;
+
+  value_t* values = new value_t[n];
+  uvalue_t* keys = new uvalue_t[n];
+  SortPair* items = new SortPair[n];
+  uint8_t* seen = new uint8_t[n];
+
+  typename pmt::rng<uvalue_t>::type rnd;
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (std::is_floating_point<value_t>::value)
+    {
+      values[i] = pmt::random_fp(rnd);
+    }
+    else
+    {
+      values[i] = rnd();
+    }
+
+    if (distribution == few_values)
+    {
+      values[i] = value_t(i % 3U);
+    }
+    else if (distribution == descending)
+    {
+      values[i] = value_t(n - i);
+    }
+
+    keys[i] = pmt::unsigned_conversion(values[i]);
+    items[i] = {keys[i], index_t(i)};
+    seen[i] = 0;
+  }
+
+  {
+    pmt::Timer t;
+    pmt::radix_sort_in_place(items, n, n_stripes);
+
+    double seconds = t.stop();
+
+    if (n > 1000000U)
+    {
+      printf("Sorted %.2e %s values in place with %zu stripes in %f seconds\n",
+        (double)n, s, n_stripes, seconds);
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    index_t k = items[i].data();
+
+    check(k < n && !seen[k]);
+    check(items[i].unsigned_value() == keys[k]);
+    check(i == 0 || items[i - 1].unsigned_value() <= items[i].unsigned_value());
+
+    seen[k] = 1;
+  }
+
+  delete[] seen;
+  delete[] items;
+  delete[] keys;
+  delete[] values;
+}
+
+template <typename value_t>
+void check_value_t(char const* s)
+{
+  size_t lengths[] = {0, 1, 31, 1000, (size_t(1) << 18U) + 3U, size_t(3) << 20U};
+  size_t stripes[] = {1, 4, 7};
+
+  for (size_t n : lengths)
+  {
+    for (size_t n_stripes : stripes)
+    {
+      check_sort<value_t>(s, n, uniform, n_stripes);
+      check_sort<value_t>(s, n, few_values, n_stripes);
+      check_sort<value_t>(s, n, descending, n_stripes);
+    }
+  }
+}
+
+int main()
+{
+  check_value_t<uint8_t>("uint8_t");
+  check_value_t<int16_t>("int16_t");
+  check_value_t<uint32_t>("uint32_t");
+  check_value_t<uint64_t>("uint64_t");
+  check_value_t<float>("float");
+
+  info("radix_sort_in_place: all tests passed");
+
+  return 0;
+}
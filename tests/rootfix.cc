@@ -83,6 +83,49 @@ void construct(index_t width, index_t height, index_t depth)
     check(vals_out2[i] == vals_out[i]);
   }
 
+  {
+    pmt::MergeSchedule<index_t> schedule;
+    pmt::schedule_rootfix(parents, n, &schedule);
+
+    // depth of every node, replayed with the recorded schedule
+    auto const &w = [=](index_t i) ALWAYS_INL_L(attribute_t)
+    {
+      return parents[i] != i;
+    };
+
+    attribute_t* depths = new attribute_t[n];
+    attribute_t* depths2 = new attribute_t[n];
+
+    pmt::rootfix(schedule, depths, w, plus);
+    pmt::rootfix_seq(parents, n, depths2, w, plus);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      check(depths[i] == depths2[i]);
+    }
+
+    index_t* order = new index_t[n];
+    pmt::topological_order(parents, n, order);
+    pmt::rootfix_seq(order, parents, n, vals_out2, w, plus);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      check(vals_out2[i] == depths2[i]);
+    }
+
+    delete[] order;
+
+    pmt::rootfix(schedule, vals_out2, w, plus);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      check(vals_out2[i] == depths2[i]);
+    }
+
+    delete[] depths2;
+    delete[] depths;
+  }
+
   out("Seems correct.");
 
   delete[] parents;
@@ -0,0 +1,248 @@
+#include <cstdint>
+#include <iostream>
+#include <cmath>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/tree_scan_seq.h"
+#include "../include/maxtree/shape_attributes.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+
+template <size_t n_dimensions, typename attribute_t, typename functor1_t, typename functor2_t>
+void check_lane(index_t* parents, index_t n, attribute_t const* result, functor1_t const& w, functor2_t const& plus)
+{
+  attribute_t* expected = new attribute_t[n];
+
+  pmt::tree_scan_seq(parents, n, expected, w, plus);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    check(result[i] == expected[i]);
+  }
+
+  delete[] expected;
+}
+
+template <size_t n_dimensions>
+void construct(pmt::Dimensions<n_dimensions> const& dims)
+{
+  using prim = pmt::primitives<index_t, value_t, n_dimensions, 2U * n_dimensions>;
+  using coordinate_t = pmt::Coordinate<prim>;
+  using shape_t = pmt::ShapeAttributes<index_t, n_dimensions>;
+
+  index_t n = dims.length();
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  pmt::Image<prim> img(vals, dims);
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % 16U;
+  });
+
+  delete[] rand;
+
+  pmt::maxtree(img, parents);
+
+  shape_t shape;
+
+  {
+    pmt::Timer t;
+    pmt::shape_attributes(img, parents, &shape);
+
+    printf("%f megapixel/s (%zu-D shape attributes)\n", n / 1e6 / t.stop(), n_dimensions);
+  }
+
+  auto const& x = [=](index_t i, size_t d) ALWAYS_INL_L(index_t)
+  {
+    return coordinate_t::from_index(i, dims)[d];
+  };
+
+  auto const& plus = [](double a, double b) ALWAYS_INL_L(double) { return a + b; };
+
+  check_lane<n_dimensions>(parents, n, shape.areas(), [](index_t i) ALWAYS_INL_L(index_t) { return 1U; },
+    [](index_t a, index_t b) ALWAYS_INL_L(index_t) { return a + b; });
+
+  for (size_t d = 0; d < n_dimensions; ++d)
+  {
+    check_lane<n_dimensions>(parents, n, shape.sums(d), [=](index_t i) ALWAYS_INL_L(double) { return x(i, d); }, plus);
+    check_lane<n_dimensions>(parents, n, shape.products(d, n_dimensions - 1U),
+      [=](index_t i) ALWAYS_INL_L(double) { return double(x(i, d)) * x(i, n_dimensions - 1U); }, plus);
+    check_lane<n_dimensions>(parents, n, shape.mins(d), [=](index_t i) ALWAYS_INL_L(index_t) { return x(i, d); },
+      [](index_t a, index_t b) ALWAYS_INL_L(index_t) { return std::min(a, b); });
+    check_lane<n_dimensions>(parents, n, shape.maxs(d), [=](index_t i) ALWAYS_INL_L(index_t) { return x(i, d); },
+      [](index_t a, index_t b) ALWAYS_INL_L(index_t) { return std::max(a, b); });
+  }
+
+  // faces to the border and to lower neighbors, minus faces to higher neighbors
+  auto const& w_perimeter = [=](index_t i) ALWAYS_INL_L(int64_t)
+  {
+    int64_t perimeter = 0;
+    index_t stride = 1U;
+
+    for (size_t d = 0; d < n_dimensions; ++d)
+    {
+      index_t c = x(i, d);
+      index_t neighbors[2] = {i - stride, i + stride};
+      bool inside[2] = {c != 0, c + 1U != dims[d]};
+
+      for (size_t k = 0; k < 2U; ++k)
+      {
+        if (!inside[k])
+        {
+          ++perimeter;
+          continue;
+        }
+
+        perimeter += vals[neighbors[k]] < vals[i];
+        perimeter -= vals[neighbors[k]] > vals[i];
+      }
+
+      stride *= dims[d];
+    }
+
+    return perimeter;
+  };
+
+  check_lane<n_dimensions>(parents, n, shape.perimeters(), w_perimeter,
+    [](int64_t a, int64_t b) ALWAYS_INL_L(int64_t) { return a + b; });
+
+  // the root is the whole image
+  int64_t border = 0;
+
+  for (size_t d = 0; d < n_dimensions; ++d)
+  {
+    border += 2 * int64_t(n / dims[d]);
+  }
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (parents[i] == i)
+    {
+      check(shape.perimeter(i) == border);
+      check(shape.area(i) == n);
+    }
+  }
+
+  info(n_dimensions << "-D shape attributes seem correct.");
+
+  delete[] parents;
+  delete[] vals;
+}
+
+// a square and a rectangle of twice the height on a flat background
+void construct_shapes()
+{
+  index_t width = 100U;
+  index_t height = 80U;
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    index_t x = i % width;
+    index_t y = i / width;
+
+    vals[i] = 0;
+    vals[i] = x >= 10U && x < 30U && y >= 10U && y < 30U ? 1U : vals[i];
+    vals[i] = x >= 50U && x < 70U && y >= 10U && y < 50U ? 2U : vals[i];
+  }
+
+  pmt::maxtree(img, parents);
+
+  pmt::ShapeAttributes<index_t, 2> shape;
+  pmt::shape_attributes(img, parents, &shape);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (parents[i] == i || vals[parents[i]] == vals[i]) continue;
+
+    double side = vals[i] == 1U ? 20.0 : 40.0;
+
+    check(shape.area(i) == 20.0 * side);
+    check(shape.perimeter(i) == 2 * (20 + int64_t(side)));
+    check(shape.extent(i, 0) == 20U && shape.extent(i, 1) == side);
+    check(std::abs(shape.centroid(i, 0) - (vals[i] == 1U ? 19.5 : 59.5)) < 1e-9);
+
+    // variances (k^2 - 1) / 12 along both axes
+    double expected = std::sqrt((side * side - 1.0) / (20.0 * 20.0 - 1.0));
+    check(std::abs(shape.elongation(i) - expected) < 1e-9);
+
+    if (vals[i] == 1U)
+    {
+      check(std::abs(shape.compactness(i) - 1.0) < 1e-9);
+    }
+    else
+    {
+      check(shape.compactness(i) < 1.0);
+    }
+  }
+
+  info("Shape attributes of a square and a rectangle seem correct.");
+
+  delete[] parents;
+  delete[] vals;
+}
+
+// a 10 x 20 x 40 box
+void construct_box()
+{
+  index_t n = 30U * 40U * 60U;
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 3>::type;
+  image_t img(vals, {30U, 40U, 60U});
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    index_t x = i % 30U;
+    index_t y = i / 30U % 40U;
+    index_t z = i / 1200U;
+
+    vals[i] = x >= 5U && x < 15U && y >= 5U && y < 25U && z >= 5U && z < 45U;
+  }
+
+  pmt::maxtree(img, parents);
+
+  pmt::ShapeAttributes<index_t, 3> shape;
+  pmt::shape_attributes(img, parents, &shape);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (parents[i] == i || vals[parents[i]] == vals[i]) continue;
+
+    check(shape.area(i) == 8000U);
+    check(shape.perimeter(i) == 2 * (200 + 400 + 800));
+    check(std::abs(shape.elongation(i) - std::sqrt(1599.0 / 99.0)) < 1e-9);
+    check(shape.compactness(i) < 1.0);
+  }
+
+  info("Shape attributes of a box seem correct.");
+
+  delete[] parents;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct<2>({500U, 300U});
+  construct<3>({60U, 50U, 40U});
+  construct_shapes();
+  construct_box();
+
+  return 0;
+}
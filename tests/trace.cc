@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "../include/common.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/parallel/trace.h"
+
+using index_t = uint32_t;
+using value_t = uint8_t;
+
+int main(int argc, char** argv)
+{
+#ifndef PMT_TRACE
+  info("PMT_TRACE is not defined, nothing to test");
+#else
+  index_t width = 1500;
+  index_t height = 1000;
+  index_t n = width * height;
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[pmt::thread_pool.max_threads()];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]();
+  });
+
+  delete[] rand;
+
+  pmt::tracer.clear();
+
+  {
+    pmt::TraceScope scope(pmt::tracer, "maxtree");
+    pmt::maxtree(img, parents);
+  }
+
+  check(std::string(pmt::tracer.label()) == "unlabelled");
+
+  std::stringstream ss;
+  pmt::tracer.write_chrome_trace(ss);
+
+  std::string json = ss.str();
+
+  check(json.find("\"traceEvents\"") != std::string::npos);
+  check(json.find("\"name\": \"ReduceEdges\"") != std::string::npos);
+  check(json.find("\"name\": \"RadixSortParallel\"") != std::string::npos);
+  check(json.find("\"name\": \"maxtree\"") != std::string::npos);
+
+  if (argc > 1)
+  {
+    std::ofstream os(argv[1]);
+    os << json;
+    info("trace written to " << argv[1]);
+  }
+
+  delete[] parents;
+  delete[] vals;
+#endif
+
+  info("trace: all tests passed");
+
+  return 0;
+}
@@ -42,9 +42,25 @@ void construct()
   });
 
   index_t* parents = new index_t[N];
+  index_t* order = new index_t[N];
 
   {
-    pmt::maxtree(img, parents);
+    pmt::maxtree(img, parents, order);
+  }
+
+  {
+    // parents before children
+    uint8_t* visited = new uint8_t[N]();
+
+    for (size_t i = 0; i < N; ++i)
+    {
+      index_t node = order[i];
+      check(!visited[node]);
+      check(visited[parents[node]] || parents[node] == node);
+      visited[node] = 1;
+    }
+
+    delete[] visited;
   }
 
   index_t* area = new index_t[N];
@@ -81,8 +97,97 @@ void construct()
 
   info("Areas match.");
 
+  {
+    auto const &weight = [](index_t i) ALWAYS_INL_L(index_t) {
+      return 1U;
+    };
+
+    auto const &plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t) {
+      return a + b;
+    };
+
+    pmt::tree_scan_seq(order, parents, N, area2, weight, plus);
+  }
+
+  for (size_t i = 0; i < N; ++i)
+  {
+    check(area[i] == area2[i]);
+  }
+
+  info("Areas in topological order match.");
+
+  {
+    uint64_t* volume = new uint64_t[N];
+    uint64_t* volume2 = new uint64_t[N];
+    value_t* max_value = new value_t[N];
+    value_t* max_value2 = new value_t[N];
+
+    auto const &weight = [](index_t i) ALWAYS_INL_L(index_t) {
+      return 1U;
+    };
+
+    auto const &plus = [](index_t a, index_t b) ALWAYS_INL_L(index_t) {
+      return a + b;
+    };
+
+    auto const &weight_volume = [=](index_t i) ALWAYS_INL_L(uint64_t) {
+      return vals[i];
+    };
+
+    auto const &plus_volume = [](uint64_t a, uint64_t b) ALWAYS_INL_L(uint64_t) {
+      return a + b;
+    };
+
+    auto const &weight_max = [=](index_t i) ALWAYS_INL_L(value_t) {
+      return vals[i];
+    };
+
+    auto const &plus_max = [](value_t a, value_t b) ALWAYS_INL_L(value_t) {
+      return std::max(a, b);
+    };
+
+    pmt::tree_scan(
+      parents,
+      N,
+      std::make_tuple(area, volume, max_value),
+      std::make_tuple(weight, weight_volume, weight_max),
+      std::make_tuple(plus, plus_volume, plus_max));
+
+    pmt::tree_scan_seq(parents, N, volume2, weight_volume, plus_volume);
+    pmt::tree_scan_seq(parents, N, max_value2, weight_max, plus_max);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+      check(area[i] == area2[i]);
+      check(volume[i] == volume2[i]);
+      check(max_value[i] == max_value2[i]);
+    }
+
+    info("Multiple attributes match.");
+
+    pmt::MergeSchedule<index_t> schedule;
+    pmt::schedule_tree_scan(parents, N, &schedule);
+
+    pmt::tree_scan(schedule, area, weight, plus);
+    pmt::tree_scan(schedule, volume, weight_volume, plus_volume);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+      check(area[i] == area2[i]);
+      check(volume[i] == volume2[i]);
+    }
+
+    info("Attributes of a recorded schedule match.");
+
+    delete[] max_value2;
+    delete[] max_value;
+    delete[] volume2;
+    delete[] volume;
+  }
+
   delete[] area;
   delete[] area2;
+  delete[] order;
   delete[] parents;
   delete[] rand;
   delete[] vals;
@@ -0,0 +1,131 @@
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "../include/image/image_blocks.h"
+#include "../include/common.h"
+#include "../include/misc/timer.h"
+#include "../include/maxtree/maxtree.h"
+#include "../include/maxtree/tree_scan.h"
+#include "../include/maxtree/topological_order.h"
+#include "../include/maxtree/tree_statistics.h"
+
+using index_t = uint32_t;
+using attribute_t = uint32_t;
+
+template <typename value_t>
+void construct(index_t width, index_t height, unsigned n_level_bits)
+{
+  index_t n = width * height;
+  size_t max_threads = pmt::thread_pool.max_threads();
+
+  value_t* vals = new value_t[n];
+  index_t* parents = new index_t[n];
+  attribute_t* areas = new attribute_t[n];
+  index_t* order = new index_t[n];
+
+  using image_t = typename pmt::image<index_t, value_t, 2, 4>::type;
+  image_t img(vals, {width, height});
+
+  using rng = typename pmt::rng<index_t>::type;
+  rng* rand = new rng[max_threads];
+
+  pmt::thread_pool.for_all(n, [=](index_t i, pmt::thread_nr_t t) {
+    vals[i] = rand[t]() % 1000U;
+  });
+
+  delete[] rand;
+
+  pmt::maxtree(img, parents, order);
+  pmt::tree_scan(parents, n, areas, [](index_t i) ALWAYS_INL_L(attribute_t) { return 1U; },
+    [](attribute_t a, attribute_t b) ALWAYS_INL_L(attribute_t) { return a + b; });
+
+  attribute_t thresholds[] = {2U, 4U, 16U, 256U, 4096U};
+  size_t n_thresholds = 5U;
+
+  pmt::TreeStatistics stats;
+
+  {
+    pmt::Timer t;
+    pmt::tree_statistics(parents, n, vals, &stats, areas, thresholds, n_thresholds, n_level_bits);
+
+    printf("%f megapixel/s (tree statistics)\n", n / 1e6 / t.stop());
+  }
+
+  // sequential reference, parents before children
+  std::vector<index_t> level_root(n), depth(n);
+  std::vector<uint8_t> has_childs(n, 0);
+
+  for (index_t k = 0; k < n; ++k)
+  {
+    index_t x = order[k];
+    index_t parent = parents[x];
+
+    level_root[x] = parent != x && vals[parent] == vals[x] ? level_root[parent] : x;
+    depth[x] = parent == x ? 0 : depth[parent] + (level_root[x] == x);
+
+    if (level_root[x] == x && parent != x)
+    {
+      has_childs[level_root[parent]] = 1;
+    }
+  }
+
+  pmt::TreeStatistics expected;
+  size_t value_bits = sizeof(value_t) * 8U;
+  unsigned shift = value_bits - std::min<size_t>(n_level_bits, value_bits);
+
+  expected.level_counts.assign(size_t(1) << (value_bits - shift), 0);
+  expected.depth_counts.assign(64U, 0);
+  expected.attribute_counts.assign(n_thresholds + 1U, 0);
+
+  for (index_t i = 0; i < n; ++i)
+  {
+    if (level_root[i] != i) continue;
+
+    expected.n_level_roots++;
+    expected.n_regional_maxima += !has_childs[i];
+    expected.max_depth = std::max<size_t>(expected.max_depth, depth[i]);
+    expected.level_counts[size_t(vals[i]) >> shift]++;
+    expected.depth_counts[pmt::log2(size_t(depth[i]) + 1U)]++;
+    expected.attribute_counts[pmt::threshold_bin(areas[i], thresholds, n_thresholds)]++;
+  }
+
+  check(stats.n_nodes == n);
+  check(stats.level_shift == shift);
+  check(stats.n_level_roots == expected.n_level_roots);
+  check(stats.n_regional_maxima == expected.n_regional_maxima);
+  check(stats.max_depth == expected.max_depth);
+  check(stats.level_counts == expected.level_counts);
+  check(stats.attribute_counts == expected.attribute_counts);
+  check(stats.depth_counts.size() == pmt::log2(stats.max_depth + 1U) + 1U);
+
+  for (size_t k = 0; k < stats.depth_counts.size(); ++k)
+  {
+    check(stats.depth_counts[k] == expected.depth_counts[k]);
+  }
+
+  std::ostringstream json;
+  std::ostringstream csv;
+
+  stats.write_json(json);
+  stats.write_csv(csv);
+
+  check(json.str().find("\"n_regional_maxima\": " + std::to_string(stats.n_regional_maxima)) != std::string::npos);
+  check(csv.str().find("attribute,5,4096,") != std::string::npos);
+
+  info("Tree statistics seem correct.");
+
+  delete[] order;
+  delete[] areas;
+  delete[] parents;
+  delete[] vals;
+}
+
+int main(int argc, char** argv)
+{
+  construct<uint16_t>(300U, 200U, 8U);
+  construct<uint16_t>(1000U, 1000U, 16U);
+
+  return 0;
+}